@@ -3,12 +3,18 @@
 void test_native_arrays();
 void test_native_2D_arrays_and_arrays_of_pointers();
 void test_list_vector_iota_shuffle();
+void test_parallel_shuffle();
+void test_permuted_view();
+void test_fast_iota();
 
 int main() {
 
     test_native_arrays();
     test_native_2D_arrays_and_arrays_of_pointers();
     test_list_vector_iota_shuffle();
+    test_parallel_shuffle();
+    test_permuted_view();
+    test_fast_iota();
 
     return 0;
 }
@@ -300,3 +306,519 @@ void map_and_print_range(
     }
     std::cout << "}";
 }
+
+// -----------------------------------------------------------------------------
+// A parallel, cache-friendly shuffle for large ranges.
+// Uses std::thread; compile with -pthread.
+//
+// std::shuffle is Fisher-Yates: each step swaps with a random earlier
+// element, which for a range much bigger than the cache is a cache miss per
+// element, on one core.  Instead (P. Sanders, "Random Permutations on
+// Distributed, External and Hierarchical Memory", 1998):
+// 1. Each thread sends each element of its part of the range to a random
+//    bucket; buckets are sized to fit in L2.  Counting first, then writing,
+//    makes each bucket one contiguous piece of a scratch buffer.  There is a
+//    power of 2 of buckets, so a bucket is just a few random bits, several
+//    from each 64-bit random number, with no bias.
+// 2. Each bucket is shuffled on its own with std::shuffle, in cache, and
+//    moved back.
+// Random bucket sizes plus a uniform shuffle of each bucket give a uniformly
+// random permutation.  Every thread and bucket has its own generator,
+// seeded from (seed, which one), so for a given seed and thread count the
+// result is always the same.  threads = 1 is the single-threaded,
+// cache-blocked variant.
+
+#include <thread>    // thread, hardware_concurrency
+#include <cstdint>   // uint64_t
+
+template <class Function>
+void run_on_threads(unsigned threads, Function function) {
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t + 1 < threads; t++) workers.emplace_back(function, t);
+    function(threads - 1);  // the calling thread takes the last one
+    for (auto& worker : workers) worker.join();
+}
+
+std::mt19937_64 shuffle_rand_gen(uint64_t seed, uint32_t purpose, uint64_t index) {
+    std::seed_seq seeds { uint32_t(seed), uint32_t(seed >> 32), purpose, uint32_t(index), uint32_t(index >> 32) };
+    return std::mt19937_64(seeds);
+}
+
+// Random bucket numbers of `bits` bits each, cut from 64-bit random numbers.
+class random_buckets {
+public:
+    random_buckets(std::mt19937_64 rand_gen, unsigned bits)
+        : rand_gen(rand_gen), bits(bits), mask((size_t(1) << bits) - 1) {}
+
+    size_t operator()() {
+        if (left < bits) {
+            word = rand_gen();
+            left = 64;
+        }
+        size_t bucket = word & mask;
+        word >>= bits;
+        left -= bits;
+        return bucket;
+    }
+
+private:
+    std::mt19937_64 rand_gen;
+    unsigned bits;
+    size_t mask;
+    uint64_t word = 0;
+    unsigned left = 0;
+};
+
+template <class RandomIt>
+void parallel_shuffle(RandomIt begin, RandomIt end, uint64_t seed,
+                      unsigned threads = std::thread::hardware_concurrency()) {
+    typedef typename std::iterator_traits<RandomIt>::value_type T;
+    const size_t size = end - begin;
+    const size_t bucket_bytes = 256 * 1024;
+    if (threads == 0) threads = 1;
+    if (size < 2) return;
+
+    unsigned bucket_bits = 0;
+    while (bucket_bits < 12 && (size_t(1) << bucket_bits) < std::max<size_t>(threads, size * sizeof(T) / bucket_bytes + 1)) {
+        bucket_bits++;
+    }
+    const size_t buckets = size_t(1) << bucket_bits;
+    auto part_begin = [=](size_t t) { return size / threads * t + std::min<size_t>(t, size % threads); };
+
+    // offsets[t * buckets + b]: first the number of elements thread t sends
+    // to bucket b, then where the next of them goes in scratch.
+    std::vector<size_t> offsets(threads * buckets);
+    run_on_threads(threads, [&](unsigned t) {
+        random_buckets pick_bucket(shuffle_rand_gen(seed, 0, t), bucket_bits);
+        size_t* counts = &offsets[t * buckets];
+        for (size_t i = part_begin(t); i < part_begin(t + 1); i++) counts[pick_bucket()]++;
+    });
+
+    std::vector<size_t> bucket_begin(buckets + 1);
+    size_t sum = 0;
+    for (size_t b = 0; b < buckets; b++) {
+        bucket_begin[b] = sum;
+        for (size_t t = 0; t < threads; t++) {
+            auto count = offsets[t * buckets + b];
+            offsets[t * buckets + b] = sum;
+            sum += count;
+        }
+    }
+    bucket_begin[buckets] = sum;
+
+    // The same generators again, to send each element to the same bucket.
+    std::vector<T> scratch(size);
+    run_on_threads(threads, [&](unsigned t) {
+        random_buckets pick_bucket(shuffle_rand_gen(seed, 0, t), bucket_bits);
+        size_t* next = &offsets[t * buckets];
+        for (size_t i = part_begin(t); i < part_begin(t + 1); i++) {
+            scratch[next[pick_bucket()]++] = std::move(begin[i]);
+        }
+    });
+
+    run_on_threads(threads, [&](unsigned t) {
+        for (size_t b = t; b < buckets; b += threads) {
+            auto rand_gen = shuffle_rand_gen(seed, 1, b);
+            auto first = scratch.begin() + bucket_begin[b];
+            auto last = scratch.begin() + bucket_begin[b + 1];
+            std::shuffle(first, last, rand_gen);
+            std::move(first, last, begin + bucket_begin[b]);
+        }
+    });
+}
+
+#include <chrono>    // steady_clock, duration, duration_cast
+
+template <class F> double seconds_to_run(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
+}
+
+bool is_permutation_of_iota(const std::vector<uint32_t>& values) {
+    std::vector<bool> seen(values.size());
+    for (auto x : values) {
+        if (x >= values.size() || seen[x]) return false;
+        seen[x] = true;
+    }
+    return true;
+}
+
+void test_parallel_shuffle() {
+
+    // Same list iterators as in test_list_vector_iota_shuffle; same seed,
+    // same thread count, same shuffle.
+    std::list<int> mylist(10);
+    std::iota(mylist.begin(), mylist.end(), 100);
+    std::vector<std::list<int>::iterator> mylist_iterators(10);
+
+    for (int round = 0; round < 2; round++) {
+        std::iota(mylist_iterators.begin(), mylist_iterators.end(), mylist.begin());
+        parallel_shuffle(mylist_iterators.begin(), mylist_iterators.end(), 2017, 2);
+        std::cout << "parallel_shuffle = { ";
+        for (auto ii : mylist_iterators) {
+            std::cout << *ii << " ";
+        }
+        std::cout << "}" << std::endl;
+    }
+    std::cout << std::endl;
+
+    // Benchmark against std::shuffle, on a range much bigger than the cache.
+
+    const size_t size = 50000000;
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> values(size);
+
+    std::iota(values.begin(), values.end(), 0);
+    std::mt19937_64 rand_gen(2017);
+    auto std_seconds = seconds_to_run([&] { std::shuffle(values.begin(), values.end(), rand_gen); });
+    std::cout << "std::shuffle of " << size << ":                " << std_seconds << "s" << std::endl;
+
+    std::iota(values.begin(), values.end(), 0);
+    auto blocked_seconds = seconds_to_run([&] { parallel_shuffle(values.begin(), values.end(), 2017, 1); });
+    std::cout << "parallel_shuffle, 1 thread:              " << blocked_seconds << "s"
+              << (is_permutation_of_iota(values) ? "" : "  NOT A PERMUTATION") << std::endl;
+
+    std::iota(values.begin(), values.end(), 0);
+    auto parallel_seconds = seconds_to_run([&] { parallel_shuffle(values.begin(), values.end(), 2017, threads); });
+    std::cout << "parallel_shuffle, " << threads << " thread(s):           " << parallel_seconds << "s"
+              << (is_permutation_of_iota(values) ? "" : "  NOT A PERMUTATION") << std::endl;
+    std::cout << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// A shuffled view of a contiguous array, instead of a vector of list iterators.
+//
+// The view keeps the elements where they are, in one contiguous array, plus
+// a permutation of 32-bit indices: 4 bytes per element instead of an 8-byte
+// iterator pointing to a separately allocated list node.  Element i of the
+// view is data[order[i]].
+// - Iterating gathers through the permutation: the indices are read in
+//   order, and each element is one lookup into the array, no node to chase.
+// - apply() rearranges the array itself into view order, in place, by
+//   following each cycle of the permutation; no second array is needed.
+//   Afterwards the view is the identity, and the array can be walked directly.
+
+#include <iterator>  // forward_iterator_tag
+
+template <class T>
+class permuted_view {
+public:
+    class iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T* pointer;
+        typedef T& reference;
+
+        iterator(T* data, const uint32_t* index) : data(data), index(index) {}
+        T& operator*() const { return data[*index]; }
+        iterator& operator++() { ++index; return *this; }
+        iterator operator++(int) { auto old = *this; ++index; return old; }
+        bool operator==(const iterator& other) const { return index == other.index; }
+        bool operator!=(const iterator& other) const { return index != other.index; }
+
+    private:
+        T* data;
+        const uint32_t* index;
+    };
+
+    permuted_view(T* data, size_t size) : data(data), order(size) {
+        std::iota(order.begin(), order.end(), 0);
+    }
+
+    size_t size() const { return order.size(); }
+    T& operator[](size_t i) const { return data[order[i]]; }
+    iterator begin() const { return iterator(data, order.data()); }
+    iterator end() const { return iterator(data, order.data() + order.size()); }
+    const std::vector<uint32_t>& permutation() const { return order; }
+
+    template <class URBG> void shuffle(URBG&& rand_gen) {
+        std::shuffle(order.begin(), order.end(), rand_gen);
+    }
+
+    void shuffle(uint64_t seed, unsigned threads) {
+        parallel_shuffle(order.begin(), order.end(), seed, threads);
+    }
+
+    // Moves data[order[i]] to data[i] for all i, then resets the view to the identity.
+    // order[j] == j marks position j as done.
+    void apply() {
+        for (uint32_t i = 0; i < order.size(); i++) {
+            if (order[i] == i) continue;
+            T first = std::move(data[i]);
+            uint32_t j = i;
+            while (order[j] != i) {
+                uint32_t next = order[j];
+                data[j] = std::move(data[next]);
+                order[j] = j;
+                j = next;
+            }
+            data[j] = std::move(first);
+            order[j] = j;
+        }
+    }
+
+private:
+    T* data;
+    std::vector<uint32_t> order;
+};
+
+void test_permuted_view() {
+
+    std::vector<int> myvector(10);
+    std::iota(myvector.begin(), myvector.end(), 100);
+
+    permuted_view<int> view(myvector.data(), myvector.size());
+    view.shuffle(std::mt19937{2017});
+    std::cout << "view     = ";
+    print_range(view.begin(), view.end());
+    std::cout << std::endl;
+
+    view.apply();
+    std::cout << "applied  = ";
+    print_range(myvector.begin(), myvector.end());
+    std::cout << std::endl;
+    std::cout << std::endl;
+
+    // Benchmark: sum over a shuffled order of 10M ints, three ways.
+
+    const size_t size = 10000000;
+    long long sums[3] = { 0, 0, 0 };
+
+    std::list<int> biglist(size);
+    std::iota(biglist.begin(), biglist.end(), 0);
+    std::vector<std::list<int>::iterator> biglist_iterators(size);
+    std::iota(biglist_iterators.begin(), biglist_iterators.end(), biglist.begin());
+    std::shuffle(biglist_iterators.begin(), biglist_iterators.end(), std::mt19937{2017});
+    auto iterators_seconds = seconds_to_run([&] { for (auto ii : biglist_iterators) sums[0] += *ii; });
+
+    std::vector<int> bigvector(size);
+    std::iota(bigvector.begin(), bigvector.end(), 0);
+    permuted_view<int> bigview(bigvector.data(), size);
+    bigview.shuffle(std::mt19937{2017});
+    auto gather_seconds = seconds_to_run([&] { for (auto x : bigview) sums[1] += x; });
+    auto apply_seconds = seconds_to_run([&] { bigview.apply(); });
+    auto applied_seconds = seconds_to_run([&] { for (auto x : bigvector) sums[2] += x; });
+
+    std::cout << "sum over " << size << " shuffled:" << std::endl;
+    std::cout << "vector<list<int>::iterator>:   " << iterators_seconds << "s" << std::endl;
+    std::cout << "permuted_view, gather:         " << gather_seconds << "s" << std::endl;
+    std::cout << "permuted_view, apply():        " << apply_seconds << "s, then "
+              << applied_seconds << "s"
+              << (sums[0] == sums[1] && sums[1] == sums[2] ? "" : "  MISMATCH") << std::endl;
+    std::cout << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// iota for big buffers of numbers.
+//
+// my_iota1/my_iota2 and std::iota write one value, then increment it, one at
+// a time.  For arithmetic types in contiguous memory, fast_iota writes a
+// whole vector register of { value + 0, value + 1, ... } per step, and
+// affine_iota, its generalization, begin[i] = a * i + b.
+// - A buffer bigger than the last-level cache is written with non-temporal
+//   (streaming) stores, which go straight to memory instead of first reading
+//   every cache line in, and evicting everything else from the cache.
+// - parallel_iota splits the buffer into one chunk per thread.
+// For floating point, a * i + b is computed for each i directly, so the
+// result is the same as from ++value only while i is exactly representable.
+// Any other iterator goes to the generic, my_iota2 loop.
+//
+// The kernel is compiled twice, with 32-byte AVX2 vectors and with 16-byte
+// SSE2 vectors, and picked at runtime, like the MinMax kernels in tuple.cpp.
+// That is on x86; elsewhere, such as ARM Macs, it is a plain loop, for the
+// compiler to vectorize, with no streaming stores.
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ARRAYS_X86 1
+#include <immintrin.h>  // _mm256_stream_si256, _mm_stream_si128, _mm_sfence
+#endif
+#include <unistd.h>     // sysconf
+#include <cstring>      // memcpy
+#include <type_traits>  // enable_if, is_arithmetic
+
+// The sizes of the caches are a glibc extension of sysconf; 8 MB where it is
+// not there.
+size_t last_level_cache_bytes() {
+    static const size_t bytes = [] {
+        long l3 = -1, l2 = -1;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+        l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+        return size_t(l3 > 0 ? l3 : l2 > 0 ? l2 : 8 << 20);
+    }();
+    return bytes;
+}
+
+#ifdef ARRAYS_X86
+
+// Non-temporal stores, one per vector size; p must be aligned to the vector size.
+inline __attribute__((always_inline)) void stream_vector(void* p, const void* v, std::integral_constant<int, 16>) {
+    __m128i x;
+    std::memcpy(&x, v, sizeof(x));
+    _mm_stream_si128(static_cast<__m128i*>(p), x);
+}
+
+__attribute__((target("avx2")))
+inline void stream_vector(void* p, const void* v, std::integral_constant<int, 32>) {
+    __m256i x;
+    std::memcpy(&x, v, sizeof(x));
+    _mm256_stream_si256(static_cast<__m256i*>(p), x);
+}
+
+template <class T, int VectorBytes>
+inline __attribute__((always_inline))
+void affine_iota_vector(T* begin, T* end, T a, T b, size_t first_index, bool nontemporal) {
+    typedef T V __attribute__((vector_size(VectorBytes)));
+    constexpr int lanes = VectorBytes / sizeof(T);
+
+    T* p = begin;
+    size_t i = first_index;
+    if (nontemporal) {
+        for (; p != end && reinterpret_cast<uintptr_t>(p) % VectorBytes != 0; p++, i++) *p = a * T(i) + b;
+    }
+
+    V index;
+    for (int lane = 0; lane < lanes; lane++) index[lane] = T(i + lane);
+    V va = index * 0 + a;  // broadcasts
+    V vb = index * 0 + b;
+    V step = index * 0 + T(lanes);
+
+    for (; end - p >= lanes; p += lanes, i += lanes) {
+        V v = index * va + vb;
+        if (nontemporal) {
+            stream_vector(p, &v, std::integral_constant<int, VectorBytes>());
+        } else {
+            std::memcpy(p, &v, sizeof(V));
+        }
+        index += step;
+    }
+    for (; p != end; p++, i++) *p = a * T(i) + b;
+
+    if (nontemporal) _mm_sfence();
+}
+
+template <class T>
+void affine_iota_sse2(T* begin, T* end, T a, T b, size_t first_index, bool nontemporal) {
+    affine_iota_vector<T, 16>(begin, end, a, b, first_index, nontemporal);
+}
+
+template <class T> __attribute__((target("avx2")))
+void affine_iota_avx2(T* begin, T* end, T a, T b, size_t first_index, bool nontemporal) {
+    affine_iota_vector<T, 32>(begin, end, a, b, first_index, nontemporal);
+}
+
+// Writes begin[i] = a * (first_index + i) + b.
+template <class T>
+void affine_iota_kernel(T* begin, T* end, T a, T b, size_t first_index, bool nontemporal) {
+    static const bool avx2 = [] { __builtin_cpu_init(); return __builtin_cpu_supports("avx2"); }();
+    (avx2 ? affine_iota_avx2<T> : affine_iota_sse2<T>)(begin, end, a, b, first_index, nontemporal);
+}
+
+#else
+
+template <class T>
+void affine_iota_kernel(T* begin, T* end, T a, T b, size_t first_index, bool) {
+    for (size_t i = first_index; begin != end; begin++, i++) *begin = a * T(i) + b;
+}
+
+#endif
+
+template <class T>
+bool use_nontemporal(const T* begin, const T* end) {
+    return size_t(end - begin) * sizeof(T) > last_level_cache_bytes();
+}
+
+template <class T, class = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+void affine_iota(T* begin, T* end, T a, T b) {
+    affine_iota_kernel(begin, end, a, b, 0, use_nontemporal(begin, end));
+}
+
+template <class ForwardIterator, class V>
+void fast_iota(ForwardIterator begin, ForwardIterator end, V value) {
+    my_iota2(begin, end, value);
+}
+
+// value is converted to T, so that fast_iota(uint32_ptr, end, 100) takes
+// this overload too, not the generic one.
+template <class T, class V, class = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+void fast_iota(T* begin, T* end, V value) {
+    affine_iota(begin, end, T(1), T(value));
+}
+
+template <class T, class = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+void parallel_affine_iota(T* begin, T* end, T a, T b,
+                          unsigned threads = std::thread::hardware_concurrency()) {
+    if (threads == 0) threads = 1;
+    const size_t size = end - begin;
+    const bool nontemporal = use_nontemporal(begin, end);
+    run_on_threads(threads, [=](unsigned t) {
+        size_t first = size / threads * t + std::min<size_t>(t, size % threads);
+        size_t last = size / threads * (t + 1) + std::min<size_t>(t + 1, size % threads);
+        affine_iota_kernel(begin + first, begin + last, a, b, first, nontemporal);
+    });
+}
+
+template <class T, class = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+void parallel_iota(T* begin, T* end, T value,
+                   unsigned threads = std::thread::hardware_concurrency()) {
+    parallel_affine_iota(begin, end, T(1), value, threads);
+}
+
+template <class Fill>
+void benchmark_iota(const char* name, std::vector<uint32_t>& buffer, int repeats, Fill fill) {
+    auto seconds = seconds_to_run([&] { for (int r = 0; r < repeats; r++) fill(buffer.data(), buffer.data() + buffer.size()); });
+    bool correct = true;
+    for (size_t i = 0; i < buffer.size(); i++) correct = correct && buffer[i] == uint32_t(7 + i);
+    std::cout << "  " << name << buffer.size() * sizeof(uint32_t) * double(repeats) / seconds / 1e9 << " GB/s"
+              << (correct ? "" : "  WRONG") << std::endl;
+    std::fill(buffer.begin(), buffer.end(), 0);
+}
+
+void benchmark_iota_of(size_t size, int repeats) {
+    std::cout << "iota of " << size << " uint32_t, "
+              << (size * sizeof(uint32_t) > last_level_cache_bytes() ? "bigger" : "smaller")
+              << " than the last-level cache:" << std::endl;
+    std::vector<uint32_t> buffer(size);
+
+    benchmark_iota("std::iota:      ", buffer, repeats, [](uint32_t* b, uint32_t* e) { std::iota(b, e, 7u); });
+    benchmark_iota("my_iota2:       ", buffer, repeats, [](uint32_t* b, uint32_t* e) { my_iota2(b, e, 7u); });
+    benchmark_iota("fast_iota:      ", buffer, repeats, [](uint32_t* b, uint32_t* e) { fast_iota(b, e, 7u); });
+    benchmark_iota("parallel_iota:  ", buffer, repeats, [](uint32_t* b, uint32_t* e) { parallel_iota(b, e, 7u); });
+}
+
+void test_fast_iota() {
+
+    int ints[10];
+    fast_iota(ints, ints + 10, 100);
+    std::cout << "fast_iota    = ";
+    print_array(ints, 10);
+    std::cout << std::endl;
+
+    uint32_t uints[10];
+    fast_iota(uints, uints + 10, 100);  // an int value, for uint32_t elements
+    std::cout << "fast_iota    = ";
+    print_range(uints, uints + 10);
+    std::cout << std::endl;
+
+    double doubles[10];
+    affine_iota(doubles, doubles + 10, 0.5, -1.0);
+    std::cout << "affine_iota  = ";
+    print_range(doubles, doubles + 10);
+    std::cout << std::endl;
+
+    std::list<int> mylist(10);
+    fast_iota(mylist.begin(), mylist.end(), 100);  // generic fallback
+    std::cout << "list         = ";
+    print_range(mylist.begin(), mylist.end());
+    std::cout << std::endl;
+    std::cout << std::endl;
+
+    benchmark_iota_of(256 * 1024, 1000);
+    benchmark_iota_of(std::max<size_t>(64 << 20, 2 * last_level_cache_bytes() / sizeof(uint32_t)), 2);
+    std::cout << std::endl;
+}
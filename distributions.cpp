@@ -9,28 +9,410 @@
 
   mt19937: deterministic random number generator using Mersenne Twister method
   http://en.cppreference.com/w/cpp/numeric/random/mersenne_twister_engine
+
+  The histograms use threads, and the entropy pool uses Linux getrandom(),
+  so compile with:
+      g++ -std=c++14 -O2 -Wall -pthread distributions.cpp -o distributions.out
 */
 
 #include <iostream>
 #include <random>
 #include <map>
 #include <string>
+#include <vector>
+#include <thread>
+#include <cstdint>
+#include <climits>
+#include <algorithm>
 
 void test_mt19937();
 void uniform_distribution_using_random_device();
+void uniform_distribution_using_buffered_random_device();
 void uniform_distribution_using_modulus_random_device();
+void uniform_distribution_using_lemire();
 void uniform_distribution_using_mt19937();
 void uniform_distribution_using_mt19937_seeded_with_random_device();
+void uniform_distribution_using_parallel_streams();
+void benchmark_histograms();
+void benchmark_engines();
+void benchmark_bounded_uniform();
+void benchmark_random_devices();
+
+struct Histogram;
+void print_histogram(std::map<int, int> histogram);
+void print_histogram(const Histogram& histogram);
 
 int main() {
     test_mt19937();
     uniform_distribution_using_random_device();
+    uniform_distribution_using_buffered_random_device();
     uniform_distribution_using_modulus_random_device();
+    uniform_distribution_using_lemire();
     uniform_distribution_using_mt19937();
     uniform_distribution_using_mt19937_seeded_with_random_device();
+    uniform_distribution_using_parallel_streams();
+    benchmark_histograms();
+    benchmark_engines();
+    benchmark_bounded_uniform();
+    benchmark_random_devices();
     return 0;
 }
 
+// -----------------------------------------------------------------------------
+// Random number engines for bulk generation.  Each one is a
+// UniformRandomBitGenerator (result_type, min(), max(), operator()), so it
+// plugs into std::uniform_int_distribution, std::shuffle and so on.
+//
+// bulk_mt19937 produces exactly the sequence of std::mt19937, but also has
+// generate(first, last), which refills the whole 624-word state and tempers
+// it eight words at a time.  The other three are faster engines altogether:
+// - xoshiro256starstar: xoshiro256** by Blackman and Vigna; 256-bit state.
+// - pcg64: PCG XSL-RR 128/64 by O'Neill; 128-bit LCG state, permuted output.
+// - philox4x32: Philox4x32-10 by Salmon et al.; counter-based, i.e. the
+//   output is a keyed hash of a 128-bit counter, four words per counter.
+//
+// For splitting one stream over threads, each can skip ahead:
+// - pcg64::discard(n) in O(log n), by composing the LCG step with itself.
+// - philox4x32::discard(n) in O(1), by adding to the counter.  Also, the
+//   upper half of the counter selects one of 2^64 independent streams.
+// - xoshiro256starstar::jump() skips 2^128 outputs, long_jump() 2^192.
+// - bulk_mt19937::discard(n) is still O(n), but only twists the state,
+//   624 words at a time, without tempering.
+
+#include <cstring>  // memcpy
+
+typedef uint32_t uint32x8 __attribute__((vector_size(32)));
+
+constexpr uint32_t kMTMatrixA = 0x9908b0df;
+constexpr uint32_t kMTUpperMask = 0x80000000;
+constexpr uint32_t kMTLowerMask = 0x7fffffff;
+
+// Twists word i of the state, or words i to i + 7 if V is uint32x8: the same
+// expressions work on one word or on eight.  Vectors stay in locals, never
+// passed by value, since their ABI differs with and without AVX.
+template <class V, int shift>
+inline __attribute__((always_inline)) void mt19937_twist_at(uint32_t* mt, int i) {
+    V current, next, shifted;
+    std::memcpy(&current, mt + i, sizeof(V));
+    std::memcpy(&next, mt + i + 1, sizeof(V));
+    std::memcpy(&shifted, mt + i + shift, sizeof(V));
+    V y = (current & kMTUpperMask) | (next & kMTLowerMask);
+    V result = shifted ^ (y >> 1) ^ ((0u - (y & 1)) & kMTMatrixA);
+    std::memcpy(mt + i, &result, sizeof(V));
+}
+
+// Tempers a word, or eight words if V is uint32x8, from `in` into `out`.
+template <class V>
+inline __attribute__((always_inline)) void mt19937_temper_at(const uint32_t* in, uint32_t* out) {
+    V y;
+    std::memcpy(&y, in, sizeof(V));
+    y ^= y >> 11;
+    y ^= (y << 7) & 0x9d2c5680;
+    y ^= (y << 15) & 0xefc60000;
+    y ^= y >> 18;
+    std::memcpy(out, &y, sizeof(V));
+}
+
+// Regenerates all 624 words of state.  Word i needs old words i, i + 1 and
+// new word i - 227 (i.e. old i + 397 before the wrap), so eight consecutive
+// words never depend on each other and can be done as one vector.
+inline __attribute__((always_inline)) void mt19937_refill_vector(uint32_t* mt) {
+    constexpr int n = 624, m = 397;
+    int i = 0;
+    for (; i + 8 <= n - m; i += 8) mt19937_twist_at<uint32x8, m>(mt, i);
+    for (; i < n - m; i++) mt19937_twist_at<uint32_t, m>(mt, i);
+    for (; i + 8 <= n - 1; i += 8) mt19937_twist_at<uint32x8, m - n>(mt, i);
+    for (; i < n - 1; i++) mt19937_twist_at<uint32_t, m - n>(mt, i);
+
+    // The last word wraps around to word 0 for its `next`.
+    uint32_t y = (mt[n - 1] & kMTUpperMask) | (mt[0] & kMTLowerMask);
+    mt[n - 1] = mt[m - 1] ^ (y >> 1) ^ ((0u - (y & 1)) & kMTMatrixA);
+}
+
+// Tempers `size` state words into out.
+inline __attribute__((always_inline)) void mt19937_temper_vector(const uint32_t* mt, uint32_t* out, size_t size) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) mt19937_temper_at<uint32x8>(mt + i, out + i);
+    for (; i < size; i++) mt19937_temper_at<uint32_t>(mt + i, out + i);
+}
+
+// The kernels are compiled twice, plain and with AVX2, and picked at runtime.
+// That is on x86; elsewhere there is only the plain one.
+#if defined(__x86_64__) || defined(__i386__)
+#define DISTRIBUTIONS_X86 1
+#endif
+
+bool has_avx2() {
+#ifdef DISTRIBUTIONS_X86
+    static const bool avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+void mt19937_refill_default(uint32_t* mt) { mt19937_refill_vector(mt); }
+void mt19937_temper_default(const uint32_t* mt, uint32_t* out, size_t size) { mt19937_temper_vector(mt, out, size); }
+
+#ifdef DISTRIBUTIONS_X86
+__attribute__((target("avx2"))) void mt19937_refill_avx2(uint32_t* mt) { mt19937_refill_vector(mt); }
+__attribute__((target("avx2"))) void mt19937_temper_avx2(const uint32_t* mt, uint32_t* out, size_t size) {
+    mt19937_temper_vector(mt, out, size);
+}
+#endif
+
+class bulk_mt19937 {
+public:
+    typedef uint32_t result_type;
+    static constexpr result_type default_seed = 5489u;
+    static constexpr size_t state_size = 624;
+
+    explicit bulk_mt19937(result_type seed = default_seed) { this->seed(seed); }
+
+    void seed(result_type seed) {
+        mt[0] = seed;
+        for (uint32_t i = 1; i < state_size; i++) mt[i] = 1812433253u * (mt[i - 1] ^ (mt[i - 1] >> 30)) + i;
+        index = state_size;
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT32_MAX; }
+
+    result_type operator()() {
+        if (index == state_size) refill();
+        result_type result;
+        mt19937_temper_at<uint32_t>(mt + index++, &result);
+        return result;
+    }
+
+    void discard(unsigned long long n) {
+        for (; n > 0 && index != state_size; n--) index++;
+        for (; n >= state_size; n -= state_size) {
+            refill();
+            index = state_size;
+        }
+        if (n > 0) {
+            refill();
+            index = n;
+        }
+    }
+
+    // Fills [first, last) with the next last - first outputs; same values as
+    // calling operator() that many times.
+    void generate(uint32_t* first, uint32_t* last) {
+        while (first != last && index != state_size) *first++ = (*this)();
+        while (first != last) {
+            refill();
+            size_t size = std::min(size_t(state_size), size_t(last - first));
+#ifdef DISTRIBUTIONS_X86
+            if (has_avx2()) mt19937_temper_avx2(mt, first, size);
+            else
+#endif
+                mt19937_temper_default(mt, first, size);
+            index = size;
+            first += size;
+        }
+    }
+
+private:
+    void refill() {
+#ifdef DISTRIBUTIONS_X86
+        if (has_avx2()) mt19937_refill_avx2(mt);
+        else
+#endif
+            mt19937_refill_default(mt);
+        index = 0;
+    }
+
+    uint32_t mt[state_size];
+    size_t index;
+};
+
+inline uint64_t rotl64(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+inline uint64_t rotr64(uint64_t x, int k) { return (x >> k) | (x << ((64 - k) & 63)); }
+
+// Seeds the larger engines from one 64-bit value, as recommended by Vigna.
+inline uint64_t splitmix64(uint64_t& x) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+class xoshiro256starstar {
+public:
+    typedef uint64_t result_type;
+
+    explicit xoshiro256starstar(uint64_t seed = 0) { this->seed(seed); }
+
+    void seed(uint64_t seed) {
+        for (auto& word : s) word = splitmix64(seed);
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT64_MAX; }
+
+    result_type operator()() {
+        uint64_t result = rotl64(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl64(s[3], 45);
+        return result;
+    }
+
+    // Same as 2^128 calls to operator(); gives 2^128 non-overlapping streams.
+    void jump() {
+        static const uint64_t polynomial[] = {
+            0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c };
+        jump(polynomial);
+    }
+
+    // Same as 2^192 calls to operator(); gives 2^64 starting points, each for
+    // up to 2^64 streams via jump().
+    void long_jump() {
+        static const uint64_t polynomial[] = {
+            0x76e15d3efefdcbbf, 0xc5004e441c522fb3, 0x77710069854ee241, 0x39109bb02acbe635 };
+        jump(polynomial);
+    }
+
+private:
+    void jump(const uint64_t polynomial[4]) {
+        uint64_t t[4] = { 0, 0, 0, 0 };
+        for (int i = 0; i < 4; i++) {
+            for (int b = 0; b < 64; b++) {
+                if (polynomial[i] & (uint64_t(1) << b)) {
+                    for (int j = 0; j < 4; j++) t[j] ^= s[j];
+                }
+                (*this)();
+            }
+        }
+        for (int j = 0; j < 4; j++) s[j] = t[j];
+    }
+
+    uint64_t s[4];
+};
+
+class pcg64 {
+public:
+    typedef uint64_t result_type;
+
+    explicit pcg64(uint64_t seed = 0) { this->seed(seed); }
+
+    void seed(uint64_t seed) {
+        state = 0;
+        step();
+        state += seed;
+        step();
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT64_MAX; }
+
+    result_type operator()() {
+        step();
+        return rotr64(uint64_t(state >> 64) ^ uint64_t(state), int(state >> 122));
+    }
+
+    // n steps of state = a * state + c are one step of state = A * state + C;
+    // A and C are built up by squaring, one bit of n at a time (F. Brown,
+    // "Random Number Generation with Arbitrary Stride", 1994).
+    void discard(unsigned long long n) {
+        unsigned __int128 total_multiplier = 1, total_increment = 0;
+        unsigned __int128 step_multiplier = multiplier, step_increment = increment;
+        for (; n > 0; n >>= 1) {
+            if (n & 1) {
+                total_multiplier *= step_multiplier;
+                total_increment = total_increment * step_multiplier + step_increment;
+            }
+            step_increment = (step_multiplier + 1) * step_increment;
+            step_multiplier *= step_multiplier;
+        }
+        state = total_multiplier * state + total_increment;
+    }
+
+private:
+    static constexpr unsigned __int128 multiplier =
+        (unsigned __int128)(0x2360ed051fc65da4ull) << 64 | 0x4385df649fccf645ull;
+    static constexpr unsigned __int128 increment =
+        (unsigned __int128)(0x5851f42d4c957f2dull) << 64 | 0x14057b7ef767814full;
+
+    void step() { state = state * multiplier + increment; }
+
+    unsigned __int128 state;
+};
+
+class philox4x32 {
+public:
+    typedef uint32_t result_type;
+
+    explicit philox4x32(uint64_t seed = 0, uint64_t stream = 0) { this->seed(seed, stream); }
+
+    void seed(uint64_t seed, uint64_t stream = 0) {
+        key[0] = uint32_t(seed);
+        key[1] = uint32_t(seed >> 32);
+        this->stream = stream;
+        position = 0;
+        index = 4;
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT32_MAX; }
+
+    result_type operator()() {
+        if (index == 4) next_block();
+        return output[index++];
+    }
+
+    void discard(unsigned long long n) {
+        for (; n > 0 && index != 4; n--) index++;
+        position += n / 4;
+        if (n % 4 != 0) {
+            next_block();
+            index = unsigned(n % 4);
+        }
+    }
+
+    // The ten-round Philox bijection of counter under key.
+    static void block(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+        uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+        uint32_t k0 = key[0], k1 = key[1];
+        for (int round = 0; round < 10; round++) {
+            uint64_t p0 = uint64_t(0xd2511f53) * c0;
+            uint64_t p1 = uint64_t(0xcd9e8d57) * c2;
+            c0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+            c1 = uint32_t(p1);
+            c2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+            c3 = uint32_t(p0);
+            k0 += 0x9e3779b9;
+            k1 += 0xbb67ae85;
+        }
+        out[0] = c0;
+        out[1] = c1;
+        out[2] = c2;
+        out[3] = c3;
+    }
+
+private:
+    // The counter is { position, stream }, 64 bits each, low words first.
+    void next_block() {
+        const uint32_t counter[4] = {
+            uint32_t(position), uint32_t(position >> 32), uint32_t(stream), uint32_t(stream >> 32) };
+        block(counter, key, output);
+        position++;
+        index = 0;
+    }
+
+    uint32_t key[2];
+    uint64_t stream;
+    uint64_t position;  // of the next block
+    uint32_t output[4];
+    unsigned index;     // of the next word in output; 4 if none left
+};
+
 void test_mt19937() {
 
     // The 10000th consecutive invocation of a default-contructed std::mt19937
@@ -52,9 +434,131 @@ void test_mt19937() {
               << "  That " << (tenthousandth == expected ? "matches" : "does not match")
               << " the spec." << std::endl;
 
+    // Same, but all 10000 at once.
+    bulk_mt19937 bulk_default;
+    std::vector<uint32_t> first10000(10000);
+    bulk_default.generate(first10000.data(), first10000.data() + first10000.size());
+    tenthousandth = first10000.back();
+    std::cout << "10000th bulk_mt19937 is " << tenthousandth << "."
+              << "  That " << (tenthousandth == expected ? "matches" : "does not match")
+              << " the spec." << std::endl;
+
+    // Same, skipping the first 9999 without computing their outputs.
+    bulk_default.seed(bulk_mt19937::default_seed);
+    bulk_default.discard(10000 - 1);
+    tenthousandth = bulk_default();
+    std::cout << "10000th bulk_mt19937 after discard is " << tenthousandth << "."
+              << "  That " << (tenthousandth == expected ? "matches" : "does not match")
+              << " the spec." << std::endl;
+
     std::cout << std::endl;
 }
 
+// -----------------------------------------------------------------------------
+// Histogram over dense integer bins lo..hi: a flat array of counters.
+//
+// std::map<int, int> costs a red-black tree lookup per sample; here a sample
+// is one increment at counts[sample - lo].  Samples must be within lo..hi.
+//
+// Counting is done into kSubHistograms interleaved copies of the counters,
+// sample i going to copy i % kSubHistograms, summed at the end.  Otherwise a
+// run of equal samples makes every increment wait for the previous store to
+// the same counter.  Large jobs are split over threads, each with its own
+// private Histogram, merged at the end; no counter is shared between threads.
+
+struct Histogram {
+    int lo;
+    std::vector<uint64_t> counts;  // counts[i] is the count of sample lo + i
+
+    Histogram(int lo, int hi) : lo(lo), counts(hi - lo + 1) {}
+
+    int hi() const { return lo + int(counts.size()) - 1; }
+    void add(int sample) { counts[sample - lo]++; }
+
+    void merge(const Histogram& other) {
+        for (size_t i = 0; i < counts.size(); i++) counts[i] += other.counts[i];
+    }
+};
+
+constexpr size_t kSubHistograms = 4;
+
+// Adds `size` samples, each one from next(), to histogram.
+template <class NextSample>
+void count_samples(Histogram& histogram, uint64_t size, NextSample next) {
+    const size_t bins = histogram.counts.size();
+    std::vector<uint64_t> sub(kSubHistograms * bins);
+    uint64_t* subcounts[kSubHistograms];
+    for (size_t j = 0; j < kSubHistograms; j++) subcounts[j] = &sub[j * bins];
+    // Indexed by sample - lo, in unsigned arithmetic: as an int subtraction
+    // it ran at half the speed.
+    const int lo = histogram.lo;
+
+    uint64_t i = 0;
+    for (; i + kSubHistograms <= size; i += kSubHistograms) {
+        for (size_t j = 0; j < kSubHistograms; j++) subcounts[j][uint32_t(next()) - uint32_t(lo)]++;
+    }
+    for (; i < size; i++) subcounts[0][uint32_t(next()) - uint32_t(lo)]++;
+
+    for (size_t j = 0; j < kSubHistograms; j++) {
+        for (size_t b = 0; b < bins; b++) histogram.counts[b] += sub[j * bins + b];
+    }
+}
+
+unsigned default_histogram_threads() {
+    auto threads = std::thread::hardware_concurrency();
+    return threads == 0 ? 1 : threads;
+}
+
+// Runs job(thread_index, first, size) over [0, size) split into `threads`
+// contiguous parts, each into its own Histogram, and merges them in order.
+template <class Job>
+Histogram parallel_histogram(int lo, int hi, uint64_t size, unsigned threads, Job job) {
+    if (threads == 0) threads = 1;
+    std::vector<Histogram> parts(threads, Histogram(lo, hi));
+    std::vector<std::thread> workers;
+
+    for (unsigned t = 0; t < threads; t++) {
+        uint64_t first = size / threads * t + std::min<uint64_t>(t, size % threads);
+        uint64_t part_size = size / threads + (t < size % threads ? 1 : 0);
+        if (t + 1 == threads) {
+            job(t, first, part_size, parts[t]);  // the calling thread does the last part
+        } else {
+            workers.emplace_back([&, t, first, part_size] { job(t, first, part_size, parts[t]); });
+        }
+    }
+    for (auto& worker : workers) worker.join();
+
+    Histogram histogram(lo, hi);
+    for (auto& part : parts) histogram.merge(part);
+    return histogram;
+}
+
+// Histogram of an array of samples.
+Histogram histogram_of(const int* samples, uint64_t size, int lo, int hi,
+                       unsigned threads = default_histogram_threads()) {
+    return parallel_histogram(lo, hi, size, threads,
+        [samples](unsigned, uint64_t first, uint64_t part_size, Histogram& part) {
+            const int* p = samples + first;
+            count_samples(part, part_size, [&p] { return *p++; });
+        });
+}
+
+// Histogram of `size` fresh samples, numbered 0 to size - 1.
+// make_sampler(first) is called once on each thread, and returns the callable
+// that draws that thread's samples, starting with sample number `first`.
+// If the sampler is positioned by `first` alone, e.g. by discard(first) on a
+// generator that uses one output per sample, or by one counter-based stream
+// per sample, then the histogram is the same for any number of threads.
+template <class MakeSampler>
+Histogram sampled_histogram(int lo, int hi, uint64_t size, MakeSampler make_sampler,
+                            unsigned threads = default_histogram_threads()) {
+    return parallel_histogram(lo, hi, size, threads,
+        [&make_sampler](unsigned, uint64_t first, uint64_t part_size, Histogram& part) {
+            auto sampler = make_sampler(first);
+            count_samples(part, part_size, sampler);
+        });
+}
+
 // Example taken from http://en.cppreference.com/w/cpp/numeric/random/random_device
 // It comes with a note:
 // demo only: the performance of many implementations of random_device degrades
@@ -66,15 +570,147 @@ void uniform_distribution_using_random_device() {
     std::random_device rand_gen;
     std::uniform_int_distribution<int> uniform_dist(0, 9);
 
-    std::map<int, int> histogram;
+    Histogram histogram(0, 9);
     for (int i = 0; i < 100000; i++) {
         auto sample = uniform_dist(rand_gen);
-        histogram[sample]++;
+        histogram.add(sample);
     }
 
-    for (auto pair : histogram) {
-        std::cout << pair.first << ": " << std::string(pair.second / 100, '*') << std::endl;
+    print_histogram(histogram);
+}
+
+// -----------------------------------------------------------------------------
+// A random_device that makes far fewer system calls.
+//
+// Each thread has its own entropy_pool: 64 KB of getrandom() output, read in
+// one call and handed out four bytes at a time.  Being per thread, it needs
+// no lock or atomic on the fast path.  With background refill on, the pool
+// has a second 64 KB buffer that is refilled on another thread while the
+// first one is used up, so a caller never waits for the kernel.
+//
+// getrandom() reads the same kernel CSPRNG as /dev/urandom, and only blocks
+// once at boot, until it is first seeded; it doesn't "run out" of entropy.
+
+#include <sys/random.h>  // getrandom
+#include <atomic>
+#include <future>
+#include <memory>
+#include <cerrno>
+#include <system_error>
+
+class entropy_pool {
+public:
+    static constexpr size_t buffer_words = 16384;  // 64 KB
+
+    // The calling thread's pool.
+    static entropy_pool& this_thread() {
+        thread_local entropy_pool pool;
+        return pool;
+    }
+
+    // Total getrandom() calls made by all pools, for the benchmark.
+    static uint64_t syscalls() { return syscall_count.load(); }
+
+    void set_background_refill(bool on) {
+        background_refill = on;
+        if (on && !spare_ready.valid()) start_spare_refill();
     }
+
+    uint32_t next() {
+        if (index == buffer_words) refill();
+        return active[index++];
+    }
+
+    entropy_pool(const entropy_pool&) = delete;
+    entropy_pool& operator=(const entropy_pool&) = delete;
+
+    ~entropy_pool() {
+        if (spare_ready.valid()) spare_ready.wait();
+    }
+
+private:
+    entropy_pool() : buffers(new uint32_t[2 * buffer_words]), active(&buffers[0]), spare(&buffers[buffer_words]) {}
+
+    static void fill(uint32_t* words) {
+        auto bytes = reinterpret_cast<char*>(words);
+        size_t size = buffer_words * sizeof(uint32_t);
+        while (size > 0) {
+            // getrandom returns at most 32 MB - 1 per call; may be cut short by a signal.
+            ssize_t got = getrandom(bytes, size, 0);
+            syscall_count++;
+            if (got < 0) {
+                if (errno == EINTR) continue;
+                throw std::system_error(errno, std::generic_category(), "getrandom");
+            }
+            bytes += got;
+            size -= size_t(got);
+        }
+    }
+
+    void start_spare_refill() {
+        uint32_t* words = spare;
+        spare_ready = std::async(std::launch::async, [words] { fill(words); });
+    }
+
+    void refill() {
+        if (spare_ready.valid()) {
+            spare_ready.get();  // rethrows an error from the background fill
+            std::swap(active, spare);
+            if (background_refill) start_spare_refill();
+        } else {
+            fill(active);
+        }
+        index = 0;
+    }
+
+    static std::atomic<uint64_t> syscall_count;
+
+    // On the heap, so the thread_local pool costs each thread a pointer of
+    // static TLS, not 128 KB.
+    std::unique_ptr<uint32_t[]> buffers;
+    uint32_t* active;
+    uint32_t* spare;
+    size_t index = buffer_words;
+    bool background_refill = false;
+    std::future<void> spare_ready;
+};
+
+std::atomic<uint64_t> entropy_pool::syscall_count { 0 };
+
+// Drop-in for std::random_device: a UniformRandomBitGenerator over the
+// calling thread's entropy_pool.
+class buffered_random_device {
+public:
+    typedef uint32_t result_type;
+
+    explicit buffered_random_device(bool background_refill = false) {
+        if (background_refill) entropy_pool::this_thread().set_background_refill(true);
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT32_MAX; }
+
+    result_type operator()() { return entropy_pool::this_thread().next(); }
+
+    double entropy() const noexcept { return 32.0; }
+};
+
+// Same as uniform_distribution_using_random_device, without a system call per sample.
+void uniform_distribution_using_buffered_random_device() {
+    std::cout << "uniform_distribution_using_buffered_random_device:" << std::endl;
+
+    buffered_random_device rand_gen;
+    std::uniform_int_distribution<int> uniform_dist(0, 9);
+
+    auto syscalls = entropy_pool::syscalls();
+    Histogram histogram(0, 9);
+    for (int i = 0; i < 100000; i++) {
+        auto sample = uniform_dist(rand_gen);
+        histogram.add(sample);
+    }
+
+    print_histogram(histogram);
+    std::cout << "getrandom calls: " << entropy_pool::syscalls() - syscalls << std::endl;
     std::cout << std::endl;
 }
 
@@ -87,6 +723,15 @@ void print_histogram(std::map<int, int> histogram) {
     std::cout << std::endl;
 }
 
+void print_histogram(const Histogram& histogram) {
+    for (int sample = histogram.lo; sample <= histogram.hi(); sample++) {
+        std::cout << sample << ": "
+                  << std::string(histogram.counts[sample - histogram.lo] / 100, '*')
+                  << std::endl;
+    }
+    std::cout << std::endl;
+}
+
 // Why do we need uniform_int_distribution when a random number generator,
 // such as random_device or mt19937, generates random integers in a range?
 // Can't we just do `randgen() % K` to get random numbers from 0 to K - 1?
@@ -103,15 +748,154 @@ void uniform_distribution_using_modulus_random_device() {
     std::random_device rand_gen;
     std::uniform_int_distribution<int> uniform_dist(0, 99);
 
-    std::map<int, int> histogram;
+    Histogram histogram(0, 10);
     for (int i = 0; i < 100000; i++) {
         auto sample = uniform_dist(rand_gen) % 11;
-        histogram[sample]++;
+        histogram.add(sample);
     }
 
     print_histogram(histogram);
 }
 
+// -----------------------------------------------------------------------------
+// Unbiased bounded integers without a division per sample, by Lemire's
+// multiply-shift method (D. Lemire, "Fast Random Integer Generation in an
+// Interval", 2019).
+//
+// Take a 32-bit random x, and the 64-bit product m = x * range.  The upper
+// half of m is in [0, range), and is what we return.  Like `x % range`, it
+// would be biased: some results get one more x than the others.  Exactly
+// those extra x are the ones whose lower half of m is below
+// threshold = 2^32 % range, so we reject those and draw again.  The lower half
+// can only be below threshold if it is below range, so the division to find
+// threshold is only needed in that rare case.
+//
+// range 0 stands for all 2^32 values (hi - lo + 1 wraps around for the full
+// range of int), and then x itself is the result.
+
+template <class URBG>
+uint32_t bounded_uniform(URBG& rand_gen, uint32_t range) {
+    static_assert(URBG::min() == 0 && URBG::max() >= UINT32_MAX, "needs 32 random bits per call");
+
+    if (range == 0) return uint32_t(rand_gen());
+    uint64_t m = uint64_t(uint32_t(rand_gen())) * range;
+    uint32_t low = uint32_t(m);
+    if (low < range) {
+        uint32_t threshold = (0u - range) % range;
+        while (low < threshold) {
+            m = uint64_t(uint32_t(rand_gen())) * range;
+            low = uint32_t(m);
+        }
+    }
+    return uint32_t(m >> 32);
+}
+
+// Draws 32-bit words in bulk where the engine can.
+template <class URBG>
+void generate_words(URBG& rand_gen, uint32_t* first, uint32_t* last) {
+    while (first != last) *first++ = uint32_t(rand_gen());
+}
+
+void generate_words(bulk_mt19937& rand_gen, uint32_t* first, uint32_t* last) {
+    rand_gen.generate(first, last);
+}
+
+constexpr size_t kUniformFillBlock = 1024;
+
+// out[i] = lo + upper half of words[i] * range, for one block.  Returns
+// whether any lower half is below threshold, i.e. needs drawing again.
+// A plain loop of a known length, which the compiler vectorizes.
+inline __attribute__((always_inline))
+bool uniform_fill_block_vector(const uint32_t* words, int* out, int lo, uint32_t range, uint32_t threshold) {
+    uint32_t rejects = 0;
+    for (size_t i = 0; i < kUniformFillBlock; i++) {
+        uint64_t m = uint64_t(words[i]) * range;
+        out[i] = int(uint32_t(lo) + uint32_t(m >> 32));
+        rejects |= uint32_t(uint32_t(m) < threshold);
+    }
+    return rejects != 0;
+}
+
+bool uniform_fill_block_default(const uint32_t* words, int* out, int lo, uint32_t range, uint32_t threshold) {
+    return uniform_fill_block_vector(words, out, lo, range, threshold);
+}
+
+#ifdef DISTRIBUTIONS_X86
+__attribute__((target("avx2")))
+bool uniform_fill_block_avx2(const uint32_t* words, int* out, int lo, uint32_t range, uint32_t threshold) {
+    return uniform_fill_block_vector(words, out, lo, range, threshold);
+}
+#endif
+
+// Fills [first, last) with uniform integers in lo..hi, with the same
+// distribution as bounded_uniform, a block of 1024 at a time.  The few
+// rejected samples are redrawn one at a time with bounded_uniform.
+template <class URBG>
+void uniform_fill(int* first, int* last, int lo, int hi, URBG& rand_gen) {
+    uint32_t range = uint32_t(hi) - uint32_t(lo) + 1;  // 0 means all 2^32 values
+    if (range == 0) {
+        uint32_t words[kUniformFillBlock];
+        while (first != last) {
+            size_t size = std::min<size_t>(kUniformFillBlock, last - first);
+            generate_words(rand_gen, words, words + size);
+            for (size_t i = 0; i < size; i++) first[i] = int(uint32_t(lo) + words[i]);
+            first += size;
+        }
+        return;
+    }
+    uint32_t threshold = (0u - range) % range;
+    auto fill_block = uniform_fill_block_default;
+#ifdef DISTRIBUTIONS_X86
+    if (has_avx2()) fill_block = uniform_fill_block_avx2;
+#endif
+
+    uint32_t words[kUniformFillBlock];
+    int block[kUniformFillBlock];
+    while (first != last) {
+        size_t size = std::min<size_t>(kUniformFillBlock, last - first);
+        generate_words(rand_gen, words, words + size);
+        int* out = size == kUniformFillBlock ? first : block;
+        if (fill_block(words, out, lo, range, threshold)) {
+            for (size_t i = 0; i < size; i++) {
+                if (uint32_t(uint64_t(words[i]) * range) < threshold) {
+                    out[i] = int(uint32_t(lo) + bounded_uniform(rand_gen, range));
+                }
+            }
+        }
+        if (out == block) std::copy(block, block + size, first);
+        first += size;
+    }
+}
+
+// The same 11 bins as above, from bounded_uniform and uniform_fill instead
+// of `% 11`: no bin stands out.
+void uniform_distribution_using_lemire() {
+    std::cout << "uniform_distribution_using_lemire:" << std::endl;
+
+    std::mt19937 rand_gen;
+    Histogram histogram(0, 10);
+    for (int i = 0; i < 100000; i++) {
+        auto sample = bounded_uniform(rand_gen, 11);
+        histogram.add(sample);
+    }
+    print_histogram(histogram);
+
+    bulk_mt19937 bulk_rand_gen;
+    std::vector<int> samples(100000);
+    uniform_fill(samples.data(), samples.data() + samples.size(), 0, 10, bulk_rand_gen);
+    print_histogram(histogram_of(samples.data(), samples.size(), 0, 10));
+
+    // The full range of int, where hi - lo + 1 wraps around to 0.
+    uniform_fill(samples.data(), samples.data() + samples.size(), INT_MIN, INT_MAX, bulk_rand_gen);
+    size_t distinct_from_first = std::count_if(samples.begin(), samples.end(), [&](int x) { return x != samples[0]; });
+    size_t negative = std::count_if(samples.begin(), samples.end(), [](int x) { return x < 0; });
+    std::cout << "INT_MIN..INT_MAX, uniform_fill: distinct-from-first=" << distinct_from_first
+              << " negative=" << negative << std::endl;
+    negative = 0;
+    for (int i = 0; i < 100000; i++) negative += int(uint32_t(INT_MIN) + bounded_uniform(rand_gen, 0)) < 0;
+    std::cout << "INT_MIN..INT_MAX, bounded_uniform: negative=" << negative << std::endl;
+}
+
 // uses the default-constructed mt19937; the same seqeuence of values for every run.
 void uniform_distribution_using_mt19937() {
     std::cout << "uniform_distribution_using_mt19937:" << std::endl;
@@ -119,10 +903,10 @@ void uniform_distribution_using_mt19937() {
     std::mt19937 rand_gen;
     std::uniform_int_distribution<int> uniform_dist(0, 9);
 
-    std::map<int, int> histogram;
+    Histogram histogram(0, 9);
     for (int i = 0; i < 100000; i++) {
         auto sample = uniform_dist(rand_gen);
-        histogram[sample]++;
+        histogram.add(sample);
     }
 
     print_histogram(histogram);
@@ -136,11 +920,246 @@ void uniform_distribution_using_mt19937_seeded_with_random_device() {
     std::mt19937 rand_gen {seed_gen()};
     std::uniform_int_distribution<int> uniform_dist(0, 9);
 
-    std::map<int, int> histogram;
+    Histogram histogram(0, 9);
     for (int i = 0; i < 100000; i++) {
         auto sample = uniform_dist(rand_gen);
-        histogram[sample]++;
+        histogram.add(sample);
     }
 
     print_histogram(histogram);
 }
+
+// The same deterministic histogram, drawn by one thread and by eight, in two ways:
+// - `pcg() % 11` uses exactly one output per sample, so each thread can jump
+//   its own pcg64 straight to its first sample with discard.
+// - uniform_int_distribution may use more than one output for a sample, so
+//   there each sample gets its own philox4x32 stream, numbered by the sample.
+void uniform_distribution_using_parallel_streams() {
+    std::cout << "uniform_distribution_using_parallel_streams:" << std::endl;
+
+    const uint64_t seed = 2017;
+    const uint64_t size = 100000;
+
+    auto make_modulus_sampler = [seed](uint64_t first) {
+        pcg64 rand_gen(seed);
+        rand_gen.discard(first);
+        return [rand_gen]() mutable { return int(rand_gen() % 11); };
+    };
+    auto serial = sampled_histogram(0, 10, size, make_modulus_sampler, 1);
+    auto parallel = sampled_histogram(0, 10, size, make_modulus_sampler, 8);
+    print_histogram(parallel);
+    std::cout << "pcg64 % 11, 1 vs. 8 threads: "
+              << (serial.counts == parallel.counts ? "identical" : "DIFFERENT") << std::endl;
+
+    auto make_stream_sampler = [seed](uint64_t first) {
+        return [seed, sample = first]() mutable {
+            philox4x32 rand_gen(seed, sample++);
+            return std::uniform_int_distribution<int>(0, 9)(rand_gen);
+        };
+    };
+    serial = sampled_histogram(0, 9, size, make_stream_sampler, 1);
+    parallel = sampled_histogram(0, 9, size, make_stream_sampler, 8);
+    print_histogram(parallel);
+    std::cout << "philox4x32 streams, 1 vs. 8 threads: "
+              << (serial.counts == parallel.counts ? "identical" : "DIFFERENT") << std::endl;
+    std::cout << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// Benchmark: std::map vs. Histogram, counting the same pre-drawn samples,
+// then Histogram drawing fresh samples on every core.
+
+#include <chrono>  // steady_clock, duration, duration_cast
+
+template <class F> double seconds_to_run(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
+}
+
+void benchmark_histograms() {
+    const uint64_t size = 100000000;
+    std::cout << "benchmark_histograms over " << size << " samples, "
+              << default_histogram_threads() << " threads:" << std::endl;
+
+    std::mt19937 rand_gen;
+    std::uniform_int_distribution<int> uniform_dist(0, 9);
+    std::vector<int> samples(size);
+    for (auto& x : samples) x = uniform_dist(rand_gen);
+
+    std::map<int, int> map_histogram;
+    auto map_seconds = seconds_to_run([&] { for (auto x : samples) map_histogram[x]++; });
+
+    Histogram single(0, 9);
+    auto single_seconds = seconds_to_run([&] { for (auto x : samples) single.add(x); });
+
+    Histogram parallel(0, 9);
+    auto parallel_seconds = seconds_to_run([&] { parallel = histogram_of(samples.data(), size, 0, 9); });
+
+    bool same = true;
+    for (int b = 0; b <= 9; b++) {
+        same = same && uint64_t(map_histogram[b]) == single.counts[b] && single.counts[b] == parallel.counts[b];
+    }
+    std::cout << "std::map<int, int>:        " << size / map_seconds / 1e6 << " M samples/s" << std::endl;
+    std::cout << "Histogram::add:            " << size / single_seconds / 1e6 << " M samples/s" << std::endl;
+    std::cout << "histogram_of:              " << size / parallel_seconds / 1e6 << " M samples/s"
+              << (same ? "" : "  MISMATCH") << std::endl;
+
+    auto sampled_seconds = seconds_to_run([&] {
+        parallel = sampled_histogram(0, 9, size, [](uint64_t first) {
+            return [rand_gen = std::mt19937(uint32_t(first)), uniform_dist = std::uniform_int_distribution<int>(0, 9)]() mutable {
+                return uniform_dist(rand_gen);
+            };
+        });
+    });
+    std::cout << "sampled_histogram:         " << size / sampled_seconds / 1e6 << " M samples/s"
+              << " (including drawing)" << std::endl;
+    std::cout << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// Benchmark: raw output throughput of each engine, in GB/s.
+
+template <class Engine>
+void benchmark_engine(const char* name, Engine engine, size_t bytes) {
+    typedef typename Engine::result_type result_type;
+    std::vector<result_type> buffer(bytes / sizeof(result_type));
+    auto seconds = seconds_to_run([&] { for (auto& x : buffer) x = engine(); });
+    std::cout << name << ": " << bytes / seconds / 1e9 << " GB/s" << std::endl;
+}
+
+void benchmark_engines() {
+    const size_t bytes = 256 << 20;
+    std::cout << "benchmark_engines filling " << (bytes >> 20) << " MB:" << std::endl;
+
+    benchmark_engine("std::mt19937                ", std::mt19937(), bytes);
+    benchmark_engine("std::mt19937_64             ", std::mt19937_64(), bytes);
+    benchmark_engine("bulk_mt19937::operator()    ", bulk_mt19937(), bytes);
+
+    std::vector<uint32_t> buffer(bytes / sizeof(uint32_t));
+    bulk_mt19937 bulk;
+    auto seconds = seconds_to_run([&] { bulk.generate(buffer.data(), buffer.data() + buffer.size()); });
+    std::cout << "bulk_mt19937::generate      : " << bytes / seconds / 1e9 << " GB/s";
+    std::mt19937 reference;
+    bool same = true;
+    for (auto x : buffer) same = same && x == reference();
+    std::cout << (same ? "" : "  MISMATCH with std::mt19937") << std::endl;
+    buffer = std::vector<uint32_t>();
+
+    benchmark_engine("xoshiro256starstar          ", xoshiro256starstar(), bytes);
+    benchmark_engine("pcg64                       ", pcg64(), bytes);
+    benchmark_engine("philox4x32                  ", philox4x32(), bytes);
+    std::cout << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// Benchmark: uniform_int_distribution vs. bounded_uniform vs. uniform_fill.
+
+void benchmark_bounded_uniform_range(int lo, int hi) {
+    const size_t size = 50000000;
+    std::vector<int> samples(size);
+    int64_t sums[4] = { 0, 0, 0, 0 };
+
+    std::mt19937 rand_gen;
+    std::uniform_int_distribution<int> uniform_dist(lo, hi);
+    auto dist_seconds = seconds_to_run([&] { for (auto& x : samples) x = uniform_dist(rand_gen); });
+    for (auto x : samples) sums[0] += x;
+
+    bulk_mt19937 bulk_rand_gen;
+    auto bulk_dist_seconds = seconds_to_run([&] { for (auto& x : samples) x = uniform_dist(bulk_rand_gen); });
+    for (auto x : samples) sums[1] += x;
+
+    uint32_t range = uint32_t(hi) - uint32_t(lo) + 1;
+    auto bounded_seconds = seconds_to_run([&] {
+        for (auto& x : samples) x = int(uint32_t(lo) + bounded_uniform(bulk_rand_gen, range));
+    });
+    for (auto x : samples) sums[2] += x;
+
+    auto fill_seconds = seconds_to_run([&] {
+        uniform_fill(samples.data(), samples.data() + size, lo, hi, bulk_rand_gen);
+    });
+    for (auto x : samples) sums[3] += x;
+
+    std::cout << lo << ".." << hi << ":" << std::endl;
+    std::cout << "  uniform_int_distribution, std::mt19937:  " << size / dist_seconds / 1e6 << " M/s, mean "
+              << double(sums[0]) / size << std::endl;
+    std::cout << "  uniform_int_distribution, bulk_mt19937:  " << size / bulk_dist_seconds / 1e6 << " M/s, mean "
+              << double(sums[1]) / size << std::endl;
+    std::cout << "  bounded_uniform, bulk_mt19937:           " << size / bounded_seconds / 1e6 << " M/s, mean "
+              << double(sums[2]) / size << std::endl;
+    std::cout << "  uniform_fill, bulk_mt19937:              " << size / fill_seconds / 1e6 << " M/s, mean "
+              << double(sums[3]) / size << std::endl;
+}
+
+void benchmark_bounded_uniform() {
+    std::cout << "benchmark_bounded_uniform:" << std::endl;
+    benchmark_bounded_uniform_range(0, 9);
+    benchmark_bounded_uniform_range(0, 1000000006);
+    benchmark_bounded_uniform_range(-2000000000, 2000000000);
+    benchmark_bounded_uniform_range(INT_MIN, INT_MAX);
+    std::cout << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// Benchmark: std::random_device vs. buffered_random_device, latency per call
+// and number of system calls.
+//
+// libstdc++'s default std::random_device may use the rdrand instruction
+// rather than the kernel; std::random_device("/dev/urandom") makes one read()
+// per call.  Its reads are counted from /proc/self/io, on Linux.
+
+#include <fstream>
+
+uint64_t read_syscalls_of_this_process() {
+    std::ifstream io("/proc/self/io");
+    std::string key;
+    uint64_t value;
+    while (io >> key >> value) {
+        if (key == "syscr:") return value;
+    }
+    return 0;
+}
+
+volatile uint32_t benchmark_sink;
+
+template <class Device>
+void benchmark_random_device(const char* name, Device& device, size_t calls, bool count_reads) {
+    // Reading /proc/self/io is itself a read() or so; measure that first.
+    auto reads = read_syscalls_of_this_process();
+    auto overhead = read_syscalls_of_this_process() - reads;
+    reads = read_syscalls_of_this_process();
+    auto getrandoms = entropy_pool::syscalls();
+    uint32_t sink = 0;
+    auto seconds = seconds_to_run([&] { for (size_t i = 0; i < calls; i++) sink ^= device(); });
+    reads = read_syscalls_of_this_process() - reads - overhead;
+    getrandoms = entropy_pool::syscalls() - getrandoms;
+    benchmark_sink = sink;
+
+    std::cout << name << ": " << seconds / calls * 1e9 << " ns/call, ";
+    if (count_reads) {
+        std::cout << reads << " read() calls";
+    } else {
+        std::cout << getrandoms << " getrandom() calls";
+    }
+    std::cout << std::endl;
+}
+
+void benchmark_random_devices() {
+    const size_t calls = 1000000;
+    std::cout << "benchmark_random_devices, " << calls << " calls each:" << std::endl;
+
+    std::random_device default_device;
+    benchmark_random_device("std::random_device()                ", default_device, calls, true);
+    std::random_device urandom_device("/dev/urandom");
+    benchmark_random_device("std::random_device(\"/dev/urandom\")  ", urandom_device, calls, true);
+    buffered_random_device buffered_device;
+    benchmark_random_device("buffered_random_device()            ", buffered_device, calls, false);
+
+    // A new thread, hence a new pool, for background refill.
+    std::thread([calls] {
+        buffered_random_device background_device(true);
+        benchmark_random_device("buffered_random_device(true)        ", background_device, calls, false);
+    }).join();
+    std::cout << std::endl;
+}
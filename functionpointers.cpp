@@ -0,0 +1,374 @@
+/*
+  The C++ side of functionpointers.c: map over any callable, inlined.
+
+  In C, map takes `int (*f)(int)`, and calls f through the pointer once per
+  element.  In C++, map can be a template over the type F of the callable.
+  Every lambda and function object has a type of its own, so every call of
+  map gets its own instance of the loop, with f known, inlined, and the loop
+  vectorized.
+
+  A plain function such as square_int has type int(int), and is passed as
+  F = int (*)(int): a pointer again.  The compiler usually still sees through
+  it when map is inlined into the caller, but to be sure, wrap it:
+  `[](int x) { return square_int(x); }`.
+
+  In C, passing square_float where int (*)(int) is expected only warns, and
+  then reads an int's bits as a float.  typed_map deduces the argument and
+  result types of f instead, checks at compile time that the array elements
+  convert to them, and converts by value, a block of lanes at a time with
+  SIMD.  When the types already match it is just map.
+
+  Compile and Run this file as:
+
+  g++ -std=c++14 -O3 -Wall -pthread functionpointers.cpp -o functionpointers_cpp.out && ./functionpointers_cpp.out
+*/
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <algorithm>  // min, max
+#include <chrono>     // steady_clock, duration, duration_cast
+#include <type_traits>
+#include <cmath>      // fabs
+
+template <class T, class U, class F>
+void map(const T* input, U* output, size_t size, F f) {
+    for (size_t i = 0; i < size; i++) {
+        output[i] = f(input[i]);
+    }
+}
+
+// Same as map, with the arrays split into one chunk per thread.
+template <class T, class U, class F>
+void parallel_map(const T* input, U* output, size_t size, F f,
+                  unsigned threads = std::thread::hardware_concurrency()) {
+    if (threads == 0) threads = 1;
+    std::vector<std::thread> workers;
+    size_t first = 0;
+    for (unsigned t = 0; t < threads; t++) {
+        size_t chunk = size / threads + (t < size % threads ? 1 : 0);
+        if (t + 1 == threads) {
+            map(input + first, output + first, chunk, f);  // the calling thread does the last one
+        } else {
+            workers.emplace_back([=] { map(input + first, output + first, chunk, f); });
+        }
+        first += chunk;
+    }
+    for (auto& worker : workers) worker.join();
+}
+
+// map6 from functionpointers.c, for comparison.
+typedef int (*unary_function)(int);
+
+void map_function_pointer(const int input[], unary_function f, int output[], size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        output[i] = f(input[i]);
+    }
+}
+
+int square_int(int x) {
+    return x * x;
+}
+
+float square_float(float x) {
+    return x * x;
+}
+
+// square_int over an array, with AVX2 intrinsics written out by hand:
+// 8 ints per vpmulld.  Like the other AVX2 code here, only on x86.
+#if defined(__x86_64__) || defined(__i386__)
+#define FUNCTIONPOINTERS_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef FUNCTIONPOINTERS_X86
+__attribute__((target("avx2")))
+void map_square_int_avx2(const int input[], int output[], size_t size) {
+    size_t vectors = size / 8;
+    for (size_t v = 0; v < vectors; v++) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input) + v);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output) + v, _mm256_mullo_epi32(x, x));
+    }
+    for (size_t i = vectors * 8; i < size; i++) {
+        output[i] = square_int(input[i]);
+    }
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// typed_map
+
+// unary_func from functionpointers.c, with the types as parameters:
+// unary_func<int, int> is int(int), and unary_func<float, float> is float(float).
+template <class R, class A> using unary_func = R(A);
+
+// The argument and result types of a unary_func pointer, or of a lambda or
+// function object with a single, non-template operator().
+template <class F> struct unary_traits : unary_traits<decltype(&F::operator())> {};
+
+template <class R, class A> struct unary_traits<unary_func<R, A>*> {
+    typedef typename std::decay<A>::type argument;
+    typedef typename std::decay<R>::type result;
+};
+
+template <class R, class A> struct unary_traits<unary_func<R, A>> : unary_traits<unary_func<R, A>*> {};
+
+template <class C, class R, class A> struct unary_traits<R (C::*)(A)> : unary_traits<unary_func<R, A>*> {};
+
+template <class C, class R, class A> struct unary_traits<R (C::*)(A) const> : unary_traits<unary_func<R, A>*> {};
+
+// Converts size lanes from T to U by value, as static_cast does.
+template <class T, class U>
+void convert_lanes(const T* input, U* output, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        output[i] = static_cast<U>(input[i]);
+    }
+}
+
+#ifdef FUNCTIONPOINTERS_X86
+
+// int <-> float 8 lanes at a time; float -> int truncates, like static_cast.
+// Elsewhere, the template above does these too.
+__attribute__((target("avx2")))
+void convert_lanes_avx2(const int* input, float* output, size_t size) {
+    size_t vectors = size / 8;
+    for (size_t v = 0; v < vectors; v++) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input) + v);
+        _mm256_storeu_ps(output + v * 8, _mm256_cvtepi32_ps(x));
+    }
+    for (size_t i = vectors * 8; i < size; i++) {
+        output[i] = static_cast<float>(input[i]);
+    }
+}
+
+__attribute__((target("avx2")))
+void convert_lanes_avx2(const float* input, int* output, size_t size) {
+    size_t vectors = size / 8;
+    for (size_t v = 0; v < vectors; v++) {
+        __m256 x = _mm256_loadu_ps(input + v * 8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output) + v, _mm256_cvttps_epi32(x));
+    }
+    for (size_t i = vectors * 8; i < size; i++) {
+        output[i] = static_cast<int>(input[i]);
+    }
+}
+
+bool has_avx2() {
+    static const bool avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return avx2;
+}
+
+inline void convert_lanes(const int* input, float* output, size_t size) {
+    if (has_avx2()) {
+        convert_lanes_avx2(input, output, size);
+    } else {
+        for (size_t i = 0; i < size; i++) output[i] = static_cast<float>(input[i]);
+    }
+}
+
+inline void convert_lanes(const float* input, int* output, size_t size) {
+    if (has_avx2()) {
+        convert_lanes_avx2(input, output, size);
+    } else {
+        for (size_t i = 0; i < size; i++) output[i] = static_cast<int>(input[i]);
+    }
+}
+
+#endif  // FUNCTIONPOINTERS_X86
+
+// The lanes of input as A: input itself when T is A, else converted into buffer.
+template <class A>
+const A* lanes_as(const A* input, A*, size_t) {
+    return input;
+}
+
+template <class A, class T>
+const A* lanes_as(const T* input, A* buffer, size_t size) {
+    convert_lanes(input, buffer, size);
+    return buffer;
+}
+
+template <class T, class U, class F>
+void typed_map(const T* input, U* output, size_t size, F f, std::true_type /* types match */) {
+    map(input, output, size, f);
+}
+
+template <class T, class U, class F>
+void typed_map(const T* input, U* output, size_t size, F f, std::false_type /* types match */) {
+    typedef typename unary_traits<F>::argument A;
+    typedef typename unary_traits<F>::result R;
+    const size_t block = 1024;  // the buffers stay in L1
+    A arguments[block];
+    R results[block];
+    for (size_t first = 0; first < size; first += block) {
+        size_t n = std::min(block, size - first);
+        const A* lanes = lanes_as(input + first, arguments, n);
+        if (std::is_same<R, U>::value) {
+            map(lanes, output + first, n, f);
+        } else {
+            map(lanes, results, n, f);
+            convert_lanes(results, output + first, n);
+        }
+    }
+}
+
+// map with the element types checked against f at compile time:
+// typed_map(ints, ints, size, square_float) squares the ints as floats, and
+// typed_map(ints, ints, size, [](const char* s) { ... }) doesn't compile.
+template <class T, class U, class F>
+void typed_map(const T* input, U* output, size_t size, F f) {
+    typedef typename unary_traits<F>::argument A;
+    typedef typename unary_traits<F>::result R;
+    static_assert(std::is_arithmetic<T>::value == std::is_arithmetic<A>::value && std::is_convertible<T, A>::value,
+                  "typed_map: the input elements don't convert to the argument of f");
+    static_assert(std::is_arithmetic<R>::value == std::is_arithmetic<U>::value && std::is_convertible<R, U>::value,
+                  "typed_map: the result of f doesn't convert to the output elements");
+    typed_map(input, output, size, f,
+              std::integral_constant<bool, std::is_same<T, A>::value && std::is_same<R, U>::value>());
+}
+
+void print_array(const int array[], size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        std::cout << array[i] << " ";
+    }
+    std::cout << std::endl;
+}
+
+void test_typed_map();
+void benchmark_map();
+
+int main() {
+    int input[] = { 1, 2, 3, 4 };
+    int output[4];
+    const size_t size = 4;
+
+    print_array(input, size);
+    std::cout << std::endl;
+
+    map(input, output, size, square_int);
+    print_array(output, size);
+    map(input, output, size, [](int x) { return square_int(x); });
+    print_array(output, size);
+    map(input, output, size, [](int x) { return x * x * x; });
+    print_array(output, size);
+    parallel_map(input, output, size, [](int x) { return x + 1; }, 2);
+    print_array(output, size);
+    typed_map(input, output, size, square_float);
+    print_array(output, size);
+    std::cout << std::endl;
+
+    test_typed_map();
+    benchmark_map();
+
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Benchmark: square_int over 100M ints, through a function pointer, through
+// the map template, with explicit AVX2 on x86, and the map template on every core.
+// The function pointer is read from a volatile variable, so that the compiler
+// can't see which function it is and inline it anyway.
+
+template <class F> double seconds_to_run(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
+}
+
+bool check_squares(const std::vector<int>& input, const std::vector<int>& output) {
+    for (size_t i = 0; i < input.size(); i++) {
+        if (output[i] != input[i] * input[i]) return false;
+    }
+    return true;
+}
+
+// Squares above 2^24 aren't exact in float, so square_float is checked
+// against the same conversions one element at a time.
+bool check_float_squares(const std::vector<int>& input, const std::vector<int>& output) {
+    for (size_t i = 0; i < input.size(); i++) {
+        if (output[i] != int(square_float(float(input[i])))) return false;
+    }
+    return true;
+}
+
+// typed_map with int and float kernels over int and float arrays, against
+// the same conversions done one element at a time.
+void test_typed_map() {
+    const size_t size = 10000;  // not a multiple of the block or of 8
+    std::vector<int> ints(size);
+    std::vector<float> floats(size);
+    for (size_t i = 0; i < size; i++) {
+        ints[i] = int(i) - 5000;
+        floats[i] = float(ints[i]) * 0.75f;
+    }
+    bool ok = true;
+
+    std::vector<int> int_output(size);
+    typed_map(ints.data(), int_output.data(), size, square_int);
+    for (size_t i = 0; i < size; i++) ok = ok && int_output[i] == ints[i] * ints[i];
+    typed_map(ints.data(), int_output.data(), size, square_float);
+    for (size_t i = 0; i < size; i++) ok = ok && int_output[i] == int(square_float(float(ints[i])));
+    typed_map(floats.data(), int_output.data(), size, square_int);
+    for (size_t i = 0; i < size; i++) ok = ok && int_output[i] == square_int(int(floats[i]));
+    typed_map(floats.data(), int_output.data(), size, [](float x) { return x * 2; });
+    for (size_t i = 0; i < size; i++) ok = ok && int_output[i] == int(floats[i] * 2);
+
+    std::vector<float> float_output(size);
+    typed_map(floats.data(), float_output.data(), size, square_float);
+    for (size_t i = 0; i < size; i++) ok = ok && float_output[i] == floats[i] * floats[i];
+    typed_map(ints.data(), float_output.data(), size, square_int);
+    for (size_t i = 0; i < size; i++) ok = ok && float_output[i] == float(ints[i] * ints[i]);
+    typed_map(ints.data(), float_output.data(), size, [](double x) { return std::fabs(x); });
+    for (size_t i = 0; i < size; i++) ok = ok && float_output[i] == float(std::abs(ints[i]));
+
+    std::cout << "test_typed_map: " << (ok ? "OK" : "FAILED") << std::endl << std::endl;
+}
+
+void benchmark_map() {
+    const size_t size = 100000000;
+    std::vector<int> input(size);
+    std::vector<int> output(size);
+    for (size_t i = 0; i < size; i++) input[i] = int(i % 46341);  // squares fit in an int
+
+    std::cout << "benchmark_map: square_int over " << size << " ints" << std::endl;
+
+    unary_function volatile f = square_int;
+    auto seconds = seconds_to_run([&] { map_function_pointer(input.data(), f, output.data(), size); });
+    std::cout << "function pointer:     " << seconds << "s"
+              << (check_squares(input, output) ? "" : "  WRONG") << std::endl;
+    std::fill(output.begin(), output.end(), 0);
+
+    seconds = seconds_to_run([&] {
+        map(input.data(), output.data(), size, [](int x) { return square_int(x); });
+    });
+    std::cout << "map template, lambda: " << seconds << "s"
+              << (check_squares(input, output) ? "" : "  WRONG") << std::endl;
+    std::fill(output.begin(), output.end(), 0);
+
+#ifdef FUNCTIONPOINTERS_X86
+    if (has_avx2()) {
+        seconds = seconds_to_run([&] { map_square_int_avx2(input.data(), output.data(), size); });
+        std::cout << "explicit AVX2:        " << seconds << "s"
+                  << (check_squares(input, output) ? "" : "  WRONG") << std::endl;
+        std::fill(output.begin(), output.end(), 0);
+    }
+#endif
+
+    seconds = seconds_to_run([&] { typed_map(input.data(), output.data(), size, square_int); });
+    std::cout << "typed_map, square_int: " << seconds << "s"
+              << (check_squares(input, output) ? "" : "  WRONG") << std::endl;
+    std::fill(output.begin(), output.end(), 0);
+
+    seconds = seconds_to_run([&] { typed_map(input.data(), output.data(), size, square_float); });
+    std::cout << "typed_map, square_float: " << seconds << "s"
+              << (check_float_squares(input, output) ? "" : "  WRONG") << std::endl;
+    std::fill(output.begin(), output.end(), 0);
+
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    seconds = seconds_to_run([&] {
+        parallel_map(input.data(), output.data(), size, [](int x) { return square_int(x); }, threads);
+    });
+    std::cout << "parallel_map, " << threads << " threads: " << seconds << "s"
+              << (check_squares(input, output) ? "" : "  WRONG") << std::endl;
+}
@@ -1,13 +1,1016 @@
 // compile this using:
-//     g++ -o gmptest gmptest.cpp -lgmpxx -lgmp
+//     g++ -O2 -pthread -o gmptest gmptest.cpp -lgmpxx -lgmp
 
 #include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <random>
+#include <string>
+#include <utility>
 #include <gmpxx.h>
 
 using namespace std;
 
+// Counting GMP's allocations, set with mp_set_memory_functions in main.
+// GMP passes the old and new sizes, so the bytes in use are known too.
+
+static atomic<size_t> gmp_allocations (0);
+static atomic<size_t> gmp_reallocations (0);
+static atomic<size_t> gmp_bytes (0);
+static atomic<size_t> gmp_peak_bytes (0);
+
+static void count_gmp_bytes (size_t old_size, size_t new_size)
+{
+  size_t bytes = gmp_bytes += new_size - old_size;  // wraps around correctly when shrinking
+  size_t peak = gmp_peak_bytes;
+  while (bytes > peak && !gmp_peak_bytes.compare_exchange_weak (peak, bytes))
+    ;
+}
+
+static void *counting_alloc (size_t size)
+{
+  gmp_allocations++;
+  count_gmp_bytes (0, size);
+  void *p = malloc (size);
+  if (p == NULL)
+    {
+      cerr << "GMP: out of memory" << endl;
+      abort ();
+    }
+  return p;
+}
+
+static void *counting_realloc (void *p, size_t old_size, size_t new_size)
+{
+  gmp_reallocations++;
+  count_gmp_bytes (old_size, new_size);
+  p = realloc (p, new_size);
+  if (p == NULL)
+    {
+      cerr << "GMP: out of memory" << endl;
+      abort ();
+    }
+  return p;
+}
+
+static void counting_free (void *p, size_t size)
+{
+  count_gmp_bytes (size, 0);
+  free (p);
+}
+
+// A fixed set of threads, running the submitted tasks in order.
+// The destructor finishes the tasks already submitted.
+class thread_pool
+{
+public:
+  explicit thread_pool (unsigned threads = thread::hardware_concurrency ())
+  {
+    for (unsigned t = 0; t < max (1u, threads); t++)
+      workers_.emplace_back ([this] { work (); });
+  }
+
+  ~thread_pool ()
+  {
+    {
+      lock_guard<mutex> lock (mutex_);
+      stopping_ = true;
+    }
+    ready_.notify_all ();
+    for (thread& worker : workers_)
+      worker.join ();
+  }
+
+  unsigned size () const { return unsigned (workers_.size ()); }
+
+  template <class F> future<typename result_of<F ()>::type> submit (F f)
+  {
+    auto task = make_shared<packaged_task<typename result_of<F ()>::type ()>> (move (f));
+    future<typename result_of<F ()>::type> result = task->get_future ();
+    {
+      lock_guard<mutex> lock (mutex_);
+      tasks_.push ([task] { (*task) (); });
+    }
+    ready_.notify_one ();
+    return result;
+  }
+
+private:
+  void work ()
+  {
+    for (;;)
+      {
+        function<void ()> task;
+        {
+          unique_lock<mutex> lock (mutex_);
+          ready_.wait (lock, [this] { return stopping_ || !tasks_.empty (); });
+          if (tasks_.empty ())
+            return;
+          task = move (tasks_.front ());
+          tasks_.pop ();
+        }
+        task ();
+      }
+  }
+
+  vector<thread> workers_;
+  queue<function<void ()>> tasks_;
+  mutex mutex_;
+  condition_variable ready_;
+  bool stopping_ = false;
+};
+
+// Sums and products of many mpz_class values, by tree reduction on threads:
+// each level of the tree adds or multiplies pairs of the level below, with
+// the pairs split between the threads.  For products, a tree also makes the
+// operands of each multiplication about the same size, which is where GMP's
+// subquadratic algorithms pay off.  Additions cost the same either way, so
+// for sums each thread first adds its part of the values into one
+// accumulator, in place, and the tree only adds those.
+//
+// The two buffers the levels alternate between are kept between calls, and
+// each result is grown to its final size before it is computed, so GMP never
+// reallocs as it writes the limbs.  GMP still allocates the scratch space of
+// its large multiplications, and the result returned is a copy.
+//
+// The threads are a thread_pool kept for the life of the batch.  The top
+// levels have fewer pairs than threads, so they don't use them all: GMP's
+// operations themselves are single threaded.
+
+class mpz_batch
+{
+public:
+  explicit mpz_batch (unsigned threads = thread::hardware_concurrency ())
+    : threads_ (max (1u, threads))
+  {
+    // The calling thread works too.
+    if (threads_ > 1)
+      pool_.reset (new thread_pool (threads_ - 1));
+  }
+
+  mpz_class sum (const vector<mpz_class>& values)
+  {
+    if (values.empty ())
+      return 0;
+    size_t parts = min (size_t (threads_), values.size ());
+    if (partials_.size () < parts)
+      partials_.resize (parts);
+    run_on_threads (parts, [&] (size_t first, size_t last) {
+      for (size_t t = first; t < last; t++)
+        {
+          size_t begin = values.size () * t / parts, end = values.size () * (t + 1) / parts;
+          size_t limbs = 0;
+          for (size_t i = begin; i < end; i++)
+            limbs = max (limbs, mpz_size (values[i].get_mpz_t ()));
+          reserve_bits (partials_[t], (limbs + 1) * GMP_NUMB_BITS);  // a carry limb: up to 2^64 values
+          partials_[t] = 0;
+          for (size_t i = begin; i < end; i++)
+            mpz_add (partials_[t].get_mpz_t (), partials_[t].get_mpz_t (), values[i].get_mpz_t ());
+        }
+    });
+    return reduce (partials_.data (), parts, false);
+  }
+
+  mpz_class product (const vector<mpz_class>& values)
+  {
+    return values.empty () ? mpz_class (1) : reduce (values.data (), values.size (), true);
+  }
+
+  // The bytes of limbs held by the buffers between calls.
+  size_t buffer_bytes () const
+  {
+    size_t bytes = 0;
+    for (const vector<mpz_class>& level : levels_)
+      for (const mpz_class& x : level)
+        bytes += x.get_mpz_t ()->_mp_alloc * sizeof (mp_limb_t);
+    for (const mpz_class& x : partials_)
+      bytes += x.get_mpz_t ()->_mp_alloc * sizeof (mp_limb_t);
+    return bytes;
+  }
+
+private:
+  static void reserve_bits (mpz_class& x, size_t bits)
+  {
+    if (size_t (x.get_mpz_t ()->_mp_alloc) * GMP_NUMB_BITS < bits)
+      mpz_realloc2 (x.get_mpz_t (), bits);
+  }
+
+  mpz_class reduce (const mpz_class *in, size_t n, bool product)
+  {
+    for (int level = 0; n > 1; level ^= 1)
+      {
+        vector<mpz_class>& out = levels_[level];
+        size_t pairs = (n + 1) / 2;
+        if (out.size () < pairs)
+          out.resize (pairs);
+        run_on_threads (pairs, [&] (size_t first, size_t last) {
+          for (size_t i = first; i < last; i++)
+            {
+              if (2 * i + 1 == n)
+                {
+                  out[i] = in[2 * i];  // the odd one out
+                  continue;
+                }
+              mpz_srcptr a = in[2 * i].get_mpz_t ();
+              mpz_srcptr b = in[2 * i + 1].get_mpz_t ();
+              size_t a_bits = mpz_sizeinbase (a, 2), b_bits = mpz_sizeinbase (b, 2);
+              if (product)
+                {
+                  reserve_bits (out[i], a_bits + b_bits);
+                  mpz_mul (out[i].get_mpz_t (), a, b);
+                }
+              else
+                {
+                  reserve_bits (out[i], max (a_bits, b_bits) + 1);
+                  mpz_add (out[i].get_mpz_t (), a, b);
+                }
+            }
+        });
+        in = out.data ();
+        n = pairs;
+      }
+    return *in;
+  }
+
+  // Runs f (first, last) on [0, size) split between the threads; the
+  // calling thread runs the last part.
+  template <class F> void run_on_threads (size_t size, F f)
+  {
+    unsigned threads = unsigned (min (size_t (threads_), size));
+    vector<future<void>> parts;
+    size_t first = 0;
+    for (unsigned t = 0; t < threads; t++)
+      {
+        size_t chunk = size / threads + (t < size % threads ? 1 : 0);
+        if (t + 1 == threads)
+          f (first, first + chunk);
+        else
+          parts.push_back (pool_->submit ([&f, first, chunk] { f (first, first + chunk); }));
+        first += chunk;
+      }
+    for (future<void>& part : parts)
+      part.get ();
+  }
+
+  unsigned threads_;
+  unique_ptr<thread_pool> pool_;
+  vector<mpz_class> levels_[2];
+  vector<mpz_class> partials_;  // of sum, one per thread
+};
+
+// An integer that is kept in an int64_t while it fits, with the overflow
+// checked by GCC's __builtin_*_overflow, and in an mpz_class, on the heap,
+// only when it doesn't.  Results that fit in an int64_t again go back to
+// the int64_t.  So 1234 + -5678 is one add and one jump, where mpz_class
+// allocates limbs for all three values.
+//
+// When one operand is big, the small one is given to GMP as a read-only
+// mpz_t over a limb on the stack (mpz_roinit_n), without allocating.
+
+class hybrid_int
+{
+  static_assert (GMP_NUMB_BITS == 64 && sizeof (long) == sizeof (int64_t),
+                 "hybrid_int expects 64-bit limbs and longs");
+
+public:
+  hybrid_int () : small_ (0) {}
+
+  template <class T, class = typename enable_if<is_integral<T>::value>::type>
+  hybrid_int (T value) : small_ (int64_t (value))
+  {
+    if (is_unsigned<T>::value && uint64_t (value) > uint64_t (INT64_MAX))
+      assign (mpz_class (static_cast<unsigned long> (value)));
+  }
+
+  hybrid_int (const mpz_class& value) : small_ (0) { assign (value); }
+
+  hybrid_int (const char *digits) : small_ (0) { assign (mpz_class (digits)); }
+
+  hybrid_int (const hybrid_int& other)
+    : small_ (other.small_), big_ (other.big_ ? new mpz_class (*other.big_) : nullptr)
+  {
+  }
+
+  hybrid_int (hybrid_int&& other) noexcept = default;
+
+  hybrid_int& operator= (const hybrid_int& other)
+  {
+    if (other.big_)
+      assign (*other.big_);
+    else
+      set_small (other.small_);
+    return *this;
+  }
+
+  hybrid_int& operator= (hybrid_int&& other) noexcept = default;
+
+  bool is_small () const { return !big_; }
+
+  mpz_class to_mpz () const { return big_ ? *big_ : mpz_class (static_cast<long> (small_)); }
+
+  hybrid_int& operator+= (const hybrid_int& other)
+  {
+    int64_t result;
+    if (!big_ && !other.big_ && !__builtin_add_overflow (small_, other.small_, &result))
+      {
+        small_ = result;
+        return *this;
+      }
+    return apply (mpz_add, *this, other);
+  }
+
+  hybrid_int& operator-= (const hybrid_int& other)
+  {
+    int64_t result;
+    if (!big_ && !other.big_ && !__builtin_sub_overflow (small_, other.small_, &result))
+      {
+        small_ = result;
+        return *this;
+      }
+    return apply (mpz_sub, *this, other);
+  }
+
+  hybrid_int& operator*= (const hybrid_int& other)
+  {
+    int64_t result;
+    if (!big_ && !other.big_ && !__builtin_mul_overflow (small_, other.small_, &result))
+      {
+        small_ = result;
+        return *this;
+      }
+    return apply (mpz_mul, *this, other);
+  }
+
+  friend hybrid_int operator+ (const hybrid_int& a, const hybrid_int& b)
+  {
+    hybrid_int result;
+    if (a.big_ || b.big_ || __builtin_add_overflow (a.small_, b.small_, &result.small_))
+      result.apply (mpz_add, a, b);
+    return result;
+  }
+
+  friend hybrid_int operator- (const hybrid_int& a, const hybrid_int& b)
+  {
+    hybrid_int result;
+    if (a.big_ || b.big_ || __builtin_sub_overflow (a.small_, b.small_, &result.small_))
+      result.apply (mpz_sub, a, b);
+    return result;
+  }
+
+  friend hybrid_int operator* (const hybrid_int& a, const hybrid_int& b)
+  {
+    hybrid_int result;
+    if (a.big_ || b.big_ || __builtin_mul_overflow (a.small_, b.small_, &result.small_))
+      result.apply (mpz_mul, a, b);
+    return result;
+  }
+
+  friend hybrid_int operator- (const hybrid_int& a) { return hybrid_int () - a; }
+
+  friend hybrid_int abs (const hybrid_int& a) { return a < 0 ? -a : a; }
+
+  friend int compare (const hybrid_int& a, const hybrid_int& b)
+  {
+    if (!a.big_ && !b.big_)
+      return (a.small_ > b.small_) - (a.small_ < b.small_);
+    mp_limb_t a_limb, b_limb;
+    mpz_t a_view, b_view;
+    return mpz_cmp (a.view (a_view, a_limb), b.view (b_view, b_limb));
+  }
+
+  friend bool operator== (const hybrid_int& a, const hybrid_int& b) { return compare (a, b) == 0; }
+  friend bool operator!= (const hybrid_int& a, const hybrid_int& b) { return compare (a, b) != 0; }
+  friend bool operator< (const hybrid_int& a, const hybrid_int& b) { return compare (a, b) < 0; }
+  friend bool operator> (const hybrid_int& a, const hybrid_int& b) { return compare (a, b) > 0; }
+  friend bool operator<= (const hybrid_int& a, const hybrid_int& b) { return compare (a, b) <= 0; }
+  friend bool operator>= (const hybrid_int& a, const hybrid_int& b) { return compare (a, b) >= 0; }
+
+  friend ostream& operator<< (ostream& out, const hybrid_int& a)
+  {
+    return a.big_ ? out << *a.big_ : out << a.small_;
+  }
+
+private:
+  void set_small (int64_t value)
+  {
+    small_ = value;
+    big_.reset ();
+  }
+
+  void assign (const mpz_class& value)
+  {
+    if (value.fits_slong_p ())
+      set_small (value.get_si ());
+    else if (big_)
+      *big_ = value;
+    else
+      big_.reset (new mpz_class (value));
+  }
+
+  // The value as an mpz_srcptr, without allocating: big_ itself, or view
+  // initialized over limb.
+  mpz_srcptr view (mpz_t view, mp_limb_t& limb) const
+  {
+    if (big_)
+      return big_->get_mpz_t ();
+    limb = small_ < 0 ? 0 - mp_limb_t (small_) : mp_limb_t (small_);
+    return mpz_roinit_n (view, &limb, small_ < 0 ? -1 : small_ > 0 ? 1 : 0);
+  }
+
+  // *this = op (a, b) with GMP, in big_, then back to small_ if it fits.
+  // a or b may be *this.
+  hybrid_int& apply (void (*op) (mpz_ptr, mpz_srcptr, mpz_srcptr), const hybrid_int& a, const hybrid_int& b)
+  {
+    mp_limb_t a_limb, b_limb;
+    mpz_t a_view, b_view;
+    mpz_srcptr x = a.view (a_view, a_limb);
+    mpz_srcptr y = b.view (b_view, b_limb);
+    if (!big_)
+      big_.reset (new mpz_class);
+    op (big_->get_mpz_t (), x, y);
+    if (big_->fits_slong_p ())
+      set_small (big_->get_si ());
+    return *this;
+  }
+
+  int64_t small_;               // the value, when big_ is null
+  unique_ptr<mpz_class> big_;   // the value, when it doesn't fit in small_
+};
+
+// Factorization into primes: trial division by the primes below 2^12, then,
+// for each composite left, Pollard's rho with Brent's cycle detection for
+// factors up to about 40 bits, then ECM (the elliptic curve method) for
+// factors up to about 25 digits, until all the factors pass Miller-Rabin.
+// Random choices (rho's c, ECM's curves) come from generators seeded with
+// fixed values, so the results and the time taken don't depend on threads.
+
+typedef vector<pair<mpz_class, unsigned>> factorization;  // (prime, exponent), by increasing prime
+
+// The primes below limit, by the sieve of Eratosthenes.
+static vector<unsigned long> primes_below (unsigned long limit)
+{
+  vector<bool> composite (limit);
+  vector<unsigned long> primes;
+  for (unsigned long i = 2; i < limit; i++)
+    {
+      if (composite[i])
+        continue;
+      primes.push_back (i);
+      for (unsigned long j = i * i; j < limit; j += i)
+        composite[j] = true;
+    }
+  return primes;
+}
+
+// Miller-Rabin.  With the first 13 primes as bases it is exact for n below
+// 3.3 * 10^24 (about 2^81); above that, 20 more random bases make the
+// chance of a composite passing less than 4^-20.
+bool is_probable_prime (const mpz_class& n)
+{
+  static const unsigned long bases[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41 };
+  if (n < 2)
+    return false;
+  for (unsigned long p : bases)
+    {
+      if (n == p)
+        return true;
+      if (mpz_divisible_ui_p (n.get_mpz_t (), p))
+        return false;
+    }
+
+  mpz_class n_minus_1 = n - 1;
+  mp_bitcnt_t s = mpz_scan1 (n_minus_1.get_mpz_t (), 0);
+  mpz_class d = n_minus_1 >> s;
+  mpz_class x;
+  auto is_witness = [&] (const mpz_class& a) {
+    mpz_powm (x.get_mpz_t (), a.get_mpz_t (), d.get_mpz_t (), n.get_mpz_t ());
+    if (x == 1 || x == n_minus_1)
+      return false;
+    for (mp_bitcnt_t i = 1; i < s; i++)
+      {
+        x = x * x % n;
+        if (x == n_minus_1)
+          return false;
+      }
+    return true;
+  };
+
+  for (unsigned long a : bases)
+    if (is_witness (a))
+      return false;
+  if (mpz_sizeinbase (n.get_mpz_t (), 2) <= 81)
+    return true;
+  gmp_randclass random (gmp_randinit_default);
+  random.seed (n);
+  for (int round = 0; round < 20; round++)
+    if (is_witness (random.get_z_range (n - 3) + 2))
+      return false;
+  return true;
+}
+
+// A factor of the composite n, 1 < factor < n, by Pollard's rho with
+// x -> x^2 + c, Brent's cycle detection, and one gcd per 128 steps.
+// 0 if there is none after about max_steps steps, and n if the cycle closed
+// on all the factors at once (then try another c).
+mpz_class pollard_rho_brent (const mpz_class& n, unsigned long c, unsigned long max_steps)
+{
+  const unsigned long batch = 128;
+  mpz_class x, y = 2, ys, q = 1, g = 1;
+  auto step = [&] (mpz_class& v) {
+    v = v * v + c;
+    v %= n;
+  };
+  for (unsigned long r = 1, steps = 0; g == 1; r *= 2)
+    {
+      if (steps > max_steps)
+        return 0;
+      x = y;
+      for (unsigned long i = 0; i < r; i++)
+        step (y);
+      for (unsigned long k = 0; k < r && g == 1; k += batch)
+        {
+          ys = y;
+          for (unsigned long i = 0; i < min (batch, r - k); i++)
+            {
+              step (y);
+              q = q * (x - y) % n;
+            }
+          g = gcd (q, n);
+        }
+      steps += 2 * r;
+    }
+  if (g == n)  // the batch went past the factor: redo it one step at a time
+    do
+      {
+        step (ys);
+        g = gcd (x - ys, n);
+      }
+    while (g == 1);
+  return g;
+}
+
+// Points (X : Z) on the Montgomery curve B y^2 = x^3 + A x^2 + x mod n,
+// with a24 = (A + 2) / 4.  Only x is needed to multiply points.
+struct montgomery_point
+{
+  mpz_class x, z;
+};
+
+struct montgomery_curve
+{
+  const mpz_class& n;
+  mpz_class a24;
+
+  montgomery_point twice (const montgomery_point& p) const
+  {
+    mpz_class sum = p.x + p.z, difference = p.x - p.z;
+    sum = sum * sum % n;
+    difference = difference * difference % n;
+    mpz_class t = sum - difference;
+    return { sum * difference % n, t * ((difference + a24 * t) % n) % n };
+  }
+
+  // p + q, given p - q.
+  montgomery_point add (const montgomery_point& p, const montgomery_point& q,
+                        const montgomery_point& difference) const
+  {
+    mpz_class u = (p.x - p.z) * (q.x + q.z) % n;
+    mpz_class v = (p.x + p.z) * (q.x - q.z) % n;
+    mpz_class sum = u + v, minus = u - v;
+    return { difference.z * (sum * sum % n) % n, difference.x * (minus * minus % n) % n };
+  }
+
+  // k p, by the Montgomery ladder.
+  montgomery_point times (const montgomery_point& p, unsigned long k) const
+  {
+    if (k == 1)
+      return p;
+    montgomery_point r0 = p, r1 = twice (p);
+    for (int bit = 62 - __builtin_clzl (k); bit >= 0; bit--)
+      if (k >> bit & 1)
+        {
+          r0 = add (r1, r0, p);
+          r1 = twice (r1);
+        }
+      else
+        {
+          r1 = add (r0, r1, p);
+          r0 = twice (r0);
+        }
+    return r0;
+  }
+};
+
+// std::gcd is C++17.
+static unsigned long gcd_ul (unsigned long a, unsigned long b)
+{
+  while (b != 0)
+    {
+      unsigned long r = a % b;
+      a = b;
+      b = r;
+    }
+  return a;
+}
+
+// A factor of the composite n, 1 < factor < n, by ECM on up to curves
+// random curves, with stage 1 up to b1 and stage 2 up to 50 b1.  0 if none
+// of them finds one.
+mpz_class ecm (const mpz_class& n, unsigned long b1, unsigned curves, gmp_randclass& random)
+{
+  const unsigned long d = 210, b2 = 50 * b1;
+  vector<unsigned long> stage1_primes = primes_below (b1 + 1);
+  vector<bool> is_prime (b2 + d + 1);
+  for (unsigned long p : primes_below (b2 + d + 1))
+    is_prime[p] = true;
+
+  for (unsigned curve = 0; curve < curves; curve++)
+    {
+      // Suyama's parametrization, for a group order divisible by 12.
+      mpz_class sigma = random.get_z_range (mpz_class (1) << 32) + 6;
+      mpz_class u = (sigma * sigma - 5) % n, v = 4 * sigma % n;
+      mpz_class u3 = u * u * u % n, v3 = v * v * v % n;
+      mpz_class numerator = (v - u) * (v - u) * (v - u) % n * ((3 * u + v) % n) % n;
+      mpz_class denominator = 16 * u3 % n * v % n, inverse;
+      if (!mpz_invert (inverse.get_mpz_t (), denominator.get_mpz_t (), n.get_mpz_t ()))
+        {
+          mpz_class g = gcd (denominator, n);
+          if (g != n)
+            return g;
+          continue;
+        }
+      montgomery_curve e { n, numerator * inverse % n };
+      montgomery_point q { u3, v3 };
+
+      // Stage 1: q = (product of the prime powers up to b1) q.
+      for (unsigned long p : stage1_primes)
+        {
+          unsigned long power = p;
+          while (power <= b1 / p)
+            power *= p;
+          q = e.times (q, power);
+        }
+      mpz_class g = gcd (q.z, n);
+      if (g != 1)
+        {
+          if (g != n)
+            return g;
+          continue;
+        }
+
+      // Stage 2: for each prime p = m d +- j in (b1, b2], with j coprime to d,
+      // (m d) q - j q has Z = 0 mod the factor when p q does, so multiply the
+      // X(md) Z(j) - X(j) Z(md) together, and take one gcd at the end.
+      vector<montgomery_point> baby (d / 2);  // baby[j] = j q, for odd j
+      montgomery_point q2 = e.twice (q);
+      baby[1] = q;
+      baby[3] = e.add (q2, q, q);
+      for (unsigned long j = 5; j < d / 2; j += 2)
+        baby[j] = e.add (baby[j - 2], q2, baby[j - 4]);
+      unsigned long m = max (1ul, b1 / d);
+      montgomery_point dq = e.times (q, d);
+      // For m == 1, previous is 0 q, the point at infinity, only used as the
+      // difference of dq and 2 dq; times takes no k = 0.
+      montgomery_point previous { 0, 0 }, giant = e.times (q, m * d);
+      if (m > 1)
+        previous = e.times (q, (m - 1) * d);
+      mpz_class product = 1;
+      for (; m * d <= b2 + d; m++)
+        {
+          for (unsigned long j = 1; j < d / 2; j += 2)
+            {
+              if (gcd_ul (j, d) != 1)
+                continue;
+              unsigned long below = m * d - j, above = m * d + j;
+              if ((below > b1 && below <= b2 && is_prime[below]) || (above > b1 && above <= b2 && is_prime[above]))
+                product = product * (giant.x * baby[j].z - baby[j].x * giant.z) % n;
+            }
+          montgomery_point next = m == 1 ? e.twice (giant) : e.add (giant, dq, previous);
+          previous = giant;
+          giant = next;
+        }
+      g = gcd (product, n);
+      if (g != 1 && g != n)
+        return g;
+    }
+  return 0;
+}
+
+// A factor of the composite n, 1 < factor < n.
+static mpz_class find_factor (const mpz_class& n)
+{
+  mpz_class factor;
+  for (unsigned long c = 1; c <= 16; c++)
+    {
+      factor = pollard_rho_brent (n, c, 1ul << 18);
+      if (factor == 0)
+        break;
+      if (factor != n)
+        return factor;
+    }
+  gmp_randclass random (gmp_randinit_default);
+  random.seed (n);
+  static const struct { unsigned long b1; unsigned curves; } stages[] = {
+    { 2000, 25 },    // factors up to about 15 digits
+    { 11000, 90 },   // 20 digits
+    { 50000, 300 },  // 25 digits
+  };
+  for (const auto& stage : stages)
+    {
+      factor = ecm (n, stage.b1, stage.curves, random);
+      if (factor != 0)
+        return factor;
+    }
+  for (unsigned long c = 17; ; c++)  // and then, only rho will finish
+    {
+      factor = pollard_rho_brent (n, c, ~0ul);
+      if (factor != n)
+        return factor;
+    }
+}
+
+// The prime factorization of |n|; empty for 0 and 1.
+factorization factor (mpz_class n)
+{
+  static const vector<unsigned long> trial_primes = primes_below (1 << 12);
+  map<mpz_class, unsigned> exponents;
+  n = abs (n);
+  if (n < 2)
+    return {};
+  for (unsigned long p : trial_primes)
+    {
+      if (n < p * p)
+        break;
+      while (mpz_divisible_ui_p (n.get_mpz_t (), p))
+        {
+          exponents[p]++;
+          n /= p;
+        }
+    }
+
+  vector<mpz_class> pending;
+  if (n > 1)
+    pending.push_back (n);
+  while (!pending.empty ())
+    {
+      mpz_class m = pending.back ();
+      pending.pop_back ();
+      if (is_probable_prime (m))
+        {
+          exponents[m]++;
+          continue;
+        }
+      // Perfect powers defeat rho and ECM: split them first.
+      bool power = false;
+      mpz_class root;
+      for (unsigned long k = 2; k < mpz_sizeinbase (m.get_mpz_t (), 2) && !power; k++)
+        if (mpz_root (root.get_mpz_t (), m.get_mpz_t (), k))
+          {
+            pending.insert (pending.end (), k, root);
+            power = true;
+          }
+      if (power)
+        continue;
+      mpz_class d = find_factor (m);
+      pending.push_back (d);
+      pending.push_back (m / d);
+    }
+  return factorization (exponents.begin (), exponents.end ());
+}
+
+// "5^1 7^1 13^2 17^1 23^1 1783^1", as in the comments of test_mt19937.
+string factorization_string (const factorization& factors)
+{
+  string result;
+  for (const auto& factor : factors)
+    {
+      if (!result.empty ())
+        result += ' ';
+      result += factor.first.get_str () + '^' + std::to_string (factor.second);
+    }
+  return result;
+}
+
+// Checks a claim like "4123659995 factorizes into 5^1 7^1 13^2 17^1 23^1 1783^1".
+bool check_factorization (const mpz_class& n, const string& claimed)
+{
+  return factorization_string (factor (n)) == claimed;
+}
+
+// The factorizations of numbers, in tasks of 64 numbers on the pool.
+vector<factorization> factor_batch (thread_pool& pool, const vector<mpz_class>& numbers)
+{
+  const size_t task_size = 64;
+  vector<factorization> results (numbers.size ());
+  vector<future<void>> done;
+  for (size_t first = 0; first < numbers.size (); first += task_size)
+    done.push_back (pool.submit ([&numbers, &results, first, task_size] {
+      for (size_t i = first; i < min (first + task_size, numbers.size ()); i++)
+        results[i] = factor (numbers[i]);
+    }));
+  for (future<void>& task : done)
+    task.get ();
+  return results;
+}
+
+// Whether factors is the factorization of n: primes, multiplying to |n|.
+bool is_factorization_of (const mpz_class& n, const factorization& factors)
+{
+  mpz_class product = 1;
+  for (const auto& factor : factors)
+    {
+      if (!is_probable_prime (factor.first))
+        return false;
+      for (unsigned e = 0; e < factor.second; e++)
+        product *= factor.first;
+    }
+  return product == abs (n) || (n == 0 && factors.empty ());
+}
+
+template <class F> double seconds_to_run (F f)
+{
+  auto start = chrono::steady_clock::now ();
+  f ();
+  auto end = chrono::steady_clock::now ();
+  return chrono::duration_cast<chrono::duration<double>> (end - start).count ();
+}
+
+// Benchmark: sums of 2^26 bits and products of 2^24 bits in total, of
+// operands from 64 bits to 1M bits, with a plain loop and with mpz_batch,
+// the first time (buffers allocated) and the second time (buffers reused).
+// Reports additions or multiplications per second, GMP's allocations and
+// reallocations during the call, the peak bytes GMP had in use, and the
+// bytes mpz_batch keeps.
+
+void benchmark_batch ()
+{
+  gmp_randclass random (gmp_randinit_default);
+  unsigned threads = max (1u, thread::hardware_concurrency ());
+  mpz_batch batch (threads);
+
+  cout << endl << "benchmark_batch: " << threads << " thread(s)" << endl;
+  cout << setw (8) << "bits" << setw (9) << "count" << setw (24) << "" << setw (14) << "ops/s"
+       << setw (9) << "allocs" << setw (9) << "reallocs" << setw (11) << "peak MB" << setw (11) << "buffer MB"
+       << endl;
+
+  for (size_t bits : { 64, 1024, 16384, 262144, 1048576 })
+    for (bool product : { false, true })
+      {
+        size_t count = max (size_t (2), (product ? size_t (1) << 24 : size_t (1) << 26) / bits);
+        vector<mpz_class> values (count);
+        for (mpz_class& x : values)
+          x = random.get_z_bits (bits) | 1;  // odd, so no product is 0
+
+        mpz_class loop_result, batch_result;
+        auto report = [&] (const char *name, double seconds, size_t allocations, size_t reallocations,
+                           size_t buffer_bytes) {
+          cout << setw (8) << bits << setw (9) << count << "  " << setw (22) << left << name << right
+               << setw (14) << setprecision (4) << (count - 1) / seconds << setw (9) << allocations
+               << setw (9) << reallocations << setw (11) << setprecision (3) << gmp_peak_bytes / 1e6
+               << setw (11) << buffer_bytes / 1e6 << endl;
+        };
+
+        // A loop multiplying into one growing product is quadratic: only for small counts.
+        if (!product || count <= 4096)
+          {
+            size_t allocations = gmp_allocations, reallocations = gmp_reallocations;
+            gmp_peak_bytes = size_t (gmp_bytes);
+            double seconds = seconds_to_run ([&] {
+              loop_result = product ? 1 : 0;
+              for (const mpz_class& x : values)
+                if (product)
+                  loop_result *= x;
+                else
+                  loop_result += x;
+            });
+            report (product ? "loop, product" : "loop, sum", seconds, gmp_allocations - allocations,
+                    gmp_reallocations - reallocations, 0);
+          }
+
+        for (int call = 0; call < 2; call++)
+          {
+            size_t allocations = gmp_allocations, reallocations = gmp_reallocations;
+            gmp_peak_bytes = size_t (gmp_bytes);
+            double seconds = seconds_to_run ([&] {
+              batch_result = product ? batch.product (values) : batch.sum (values);
+            });
+            const char *name = product ? (call == 0 ? "mpz_batch, product" : "mpz_batch, product again")
+                                       : (call == 0 ? "mpz_batch, sum" : "mpz_batch, sum again");
+            report (name, seconds, gmp_allocations - allocations, gmp_reallocations - reallocations,
+                    batch.buffer_bytes ());
+          }
+
+        if ((!product || count <= 4096) && batch_result != loop_result)
+          cout << "WRONG" << endl;
+        batch = mpz_batch (threads);  // free the buffers before the next size
+      }
+}
+
+// Benchmark: r[i] = a[i] * b[i] + c[i] for 1M triples, where 99% of the
+// values are below 2^31 and 1% are 4096-bit, with mpz_class and with
+// hybrid_int.
+
+void benchmark_hybrid_int ()
+{
+  const size_t count = 1000000;
+  gmp_randclass random (gmp_randinit_default);
+  random.seed (42);
+  vector<mpz_class> values (3 * count);
+  for (mpz_class& x : values)
+    {
+      bool huge = random.get_z_range (100) == 0;
+      x = random.get_z_bits (huge ? 4096 : 31);
+      if (random.get_z_range (2) == 0)
+        x = -x;
+    }
+  vector<hybrid_int> hybrid_values (values.begin (), values.end ());
+
+  cout << endl << "benchmark_hybrid_int: r[i] = a[i] * b[i] + c[i] for " << count
+       << " triples, 1% of the values 4096-bit" << endl;
+
+  vector<mpz_class> mpz_results (count);
+  size_t allocations = gmp_allocations + gmp_reallocations;
+  double seconds = seconds_to_run ([&] {
+    for (size_t i = 0; i < count; i++)
+      mpz_results[i] = values[3 * i] * values[3 * i + 1] + values[3 * i + 2];
+  });
+  cout << "mpz_class:  " << seconds << "s, " << gmp_allocations + gmp_reallocations - allocations
+       << " GMP allocations" << endl;
+
+  vector<hybrid_int> hybrid_results (count);
+  allocations = gmp_allocations + gmp_reallocations;
+  seconds = seconds_to_run ([&] {
+    for (size_t i = 0; i < count; i++)
+      hybrid_results[i] = hybrid_values[3 * i] * hybrid_values[3 * i + 1] + hybrid_values[3 * i + 2];
+  });
+  allocations = gmp_allocations + gmp_reallocations - allocations;
+  bool ok = true;
+  for (size_t i = 0; i < count; i++)
+    ok = ok && hybrid_results[i].to_mpz () == mpz_results[i];
+  cout << "hybrid_int: " << seconds << "s, " << allocations << " GMP allocations" << (ok ? "" : "  WRONG")
+       << endl;
+}
+
+// Benchmark: factoring 100000 outputs of mt19937 and 10000 of mt19937_64
+// on a thread pool of 1 thread and of one per core, and 2^128 + 1 (the
+// Fermat number F7, a product of a 17-digit and a 22-digit prime), which
+// takes ECM.
+
+void benchmark_factor ()
+{
+  unsigned cores = max (1u, thread::hardware_concurrency ());
+  mt19937 mt;
+  mt19937_64 mt64;
+  vector<mpz_class> outputs32 (100000), outputs64 (10000);
+  for (mpz_class& x : outputs32)
+    x = static_cast<unsigned long> (mt ());
+  for (mpz_class& x : outputs64)
+    x = static_cast<unsigned long> (mt64 ());
+
+  cout << endl << "benchmark_factor:" << endl;
+  for (unsigned threads : { 1u, cores })
+    {
+      thread_pool pool (threads);
+      for (const vector<mpz_class> *numbers : { &outputs32, &outputs64 })
+        {
+          vector<factorization> results;
+          double seconds = seconds_to_run ([&] { results = factor_batch (pool, *numbers); });
+          bool ok = true;
+          for (size_t i = 0; i < numbers->size (); i++)
+            ok = ok && is_factorization_of ((*numbers)[i], results[i]);
+          cout << numbers->size () << (numbers == &outputs32 ? " mt19937" : " mt19937_64") << " outputs, "
+               << threads << " thread(s): " << numbers->size () / seconds << " numbers/s"
+               << (ok ? "" : "  WRONG") << endl;
+        }
+      if (cores == 1)
+        break;
+    }
+
+  mpz_class f7 = (mpz_class (1) << 128) + 1;
+  factorization factors;
+  double seconds = seconds_to_run ([&] { factors = factor (f7); });
+  cout << "2^128 + 1 = " << factorization_string (factors) << ", in " << seconds << "s"
+       << (is_factorization_of (f7, factors) ? "" : "  WRONG") << endl;
+}
+
 int main (void)
 {
+  mp_set_memory_functions (counting_alloc, counting_realloc, counting_free);
+
   mpz_class a, b, c;
   
   a = 1234;
@@ -15,6 +1018,40 @@ int main (void)
   c = a+b;
   cout << "sum is " << c << "\n";
   cout << "absolute value is " << abs(c) << "\n";
+
+  hybrid_int x, y, z;
+
+  x = 1234;
+  y = "-5678";
+  z = x+y;
+  cout << "hybrid_int sum is " << z << (z.is_small () ? " (int64_t)" : " (mpz_class)") << "\n";
+  cout << "absolute value is " << abs(z) << "\n";
+  z = hybrid_int (INT64_MAX) + 1;
+  cout << "INT64_MAX + 1 is " << z << (z.is_small () ? " (int64_t)" : " (mpz_class)") << "\n";
+  z -= 2;
+  cout << "minus 2 is " << z << (z.is_small () ? " (int64_t)" : " (mpz_class)") << "\n";
+  cout << "abs (INT64_MIN) is " << abs (hybrid_int (INT64_MIN)) << "\n";
+
+  vector<mpz_class> values;
+  for (int i = 1; i <= 20; i++)
+    values.push_back (i);
+  mpz_batch batch;
+  cout << "sum of 1..20 is " << batch.sum (values) << "\n";
+  cout << "product of 1..20 is " << batch.product (values) << "\n";
+
+  // The claims in the comments of test_mt19937 in distributions.cpp.
+  const pair<unsigned long, const char *> claims[] = {
+    { 4123659995, "5^1 7^1 13^2 17^1 23^1 1783^1" },
+    { 4123659996, "2^2 3^3 137^1 278701^1" },
+    { 171307300, "2^2 5^2 17^1 100769^1" },
+  };
+  for (const auto& claim : claims)
+    cout << claim.first << " factorizes into " << claim.second << ": "
+         << (check_factorization (claim.first, claim.second) ? "true" : "false") << "\n";
+
+  benchmark_factor ();
+  benchmark_hybrid_int ();
+  benchmark_batch ();
   
   return 0;
 }
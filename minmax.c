@@ -17,10 +17,28 @@
   This file is pretty much a summary of that discussion.
   https://stackoverflow.com/questions/3437404/min-and-max-in-c
 
-  TODO: integer min/max using bit hacks
-  TODO: two variants that avoid double evaluation
-  TODO: variant that avoids mismatching types
+  After the macros, the alternatives:
+  - static inline functions, one per type: single evaluation, type checked.
+  - integer min/max using bit hacks, without branches.
+  - MIN_ONCE/MAX_ONCE: GCC statement expressions, single evaluation, and a
+    warning (an error in C++) on mismatching types.
+  - In C++, constexpr templates, where mismatching types don't compile.
+  - float/double versions that treat -0.0 < +0.0 and ignore NaN, the same
+    with every compiler.
+  - SIMD min/max of arrays.
+  - min, max, minmax, argmin, argmax and clamp of float and double arrays,
+    with explicit NaN and signed zero policies, SIMD and multithreaded.
+
+  Compile and Run this file as:
+
+  gcc -O2 -Wall -pthread minmax.c -o minmax.out -lm && ./minmax.out
+  g++ -x c++ -O2 -Wall -pthread minmax.c -o minmax_cpp.out && ./minmax_cpp.out
+
+  -lm is for fminf, fmaxf and the like.  The benchmarks use clock_gettime, a
+  POSIX function, so that it is there with -std=c11 too.
 */
+#define _POSIX_C_SOURCE 200112L  /* clock_gettime, even with -std=c11 */
+
 #include <stdio.h>
 
 /* Rookie attempt, with no parentheses.  Several failure modes. */
@@ -177,12 +195,1074 @@ void test4() {
     printf("\n");
 }
 
+#undef MIN
+#undef MAX
+
+/*
+  Inline functions.  Each argument is evaluated once, before the call, and
+  converted to the parameter type, so MIN(x++, y++) problems go away.
+  One function per type though, as C has no templates.
+
+  The branchless versions use the bit hack from Sean Anderson's Bit Twiddling
+  Hacks: -(x < y) is all ones when x < y, and 0 otherwise, so
+  y ^ ((x ^ y) & -(x < y)) is y ^ x ^ y = x when x < y, and y otherwise.
+  Compilers usually emit cmov for the plain versions too; the bit hack makes
+  sure of it.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFINE_MINMAX(name, type) \
+    static inline type min_##name(type x, type y) { return x < y ? x : y; } \
+    static inline type max_##name(type x, type y) { return x > y ? x : y; } \
+    static inline type branchless_min_##name(type x, type y) { return y ^ ((x ^ y) & -(type) (x < y)); } \
+    static inline type branchless_max_##name(type x, type y) { return x ^ ((x ^ y) & -(type) (x < y)); }
+
+DEFINE_MINMAX(int, int)
+DEFINE_MINMAX(uint, unsigned int)
+DEFINE_MINMAX(llong, long long)
+DEFINE_MINMAX(ullong, unsigned long long)
+
+/*
+  IEEE-consistent floating point min/max.  The order is the one of
+  IEEE 754-2019 minimumNumber/maximumNumber:
+  - -0.0 < +0.0, which fminf/fmaxf and the macros don't guarantee (see test3);
+  - a NaN argument is ignored, as in fminf/fmaxf; NaN only if both are NaN.
+*/
+
+static inline float min_float(float x, float y) {
+    if (x != x) return y;
+    if (y != y) return x;
+    if (x == y) return signbit(x) ? x : y;
+    return x < y ? x : y;
+}
+
+static inline float max_float(float x, float y) {
+    if (x != x) return y;
+    if (y != y) return x;
+    if (x == y) return signbit(x) ? y : x;
+    return x > y ? x : y;
+}
+
+static inline double min_double(double x, double y) {
+    if (x != x) return y;
+    if (y != y) return x;
+    if (x == y) return signbit(x) ? x : y;
+    return x < y ? x : y;
+}
+
+static inline double max_double(double x, double y) {
+    if (x != x) return y;
+    if (y != y) return x;
+    if (x == y) return signbit(x) ? y : x;
+    return x > y ? x : y;
+}
+
+/*
+  Single evaluation as macros, using GCC statement expressions and typeof,
+  like the Linux kernel's min/max.  Comparing &_x with &_y warns about
+  "comparison of distinct pointer types" when x and y have different types.
+*/
+
+#define MIN_ONCE(x, y) ({ \
+    __typeof__(x) _x = (x); \
+    __typeof__(y) _y = (y); \
+    (void) (&_x == &_y); \
+    _x < _y ? _x : _y; })
+
+#define MAX_ONCE(x, y) ({ \
+    __typeof__(x) _x = (x); \
+    __typeof__(y) _y = (y); \
+    (void) (&_x == &_y); \
+    _x > _y ? _x : _y; })
+
+#ifdef __cplusplus
+
+/*
+  C++: one template for every type, usable in constant expressions.  Both
+  arguments must have the same type T, so min_of(-1, 1u) doesn't compile
+  (where std::min(-1, 1u) doesn't either, but MIN(-1, 1u) is 1u).
+  float and double are overloaded with the IEEE-consistent versions, which
+  aren't constexpr: the sign of a zero can't be read in a constant expression
+  before C++20's bit_cast.
+*/
+
+template <class T> constexpr T min_of(T x, T y) { return y < x ? y : x; }
+template <class T> constexpr T max_of(T x, T y) { return x < y ? y : x; }
+
+inline float min_of(float x, float y) { return min_float(x, y); }
+inline float max_of(float x, float y) { return max_float(x, y); }
+inline double min_of(double x, double y) { return min_double(x, y); }
+inline double max_of(double x, double y) { return max_double(x, y); }
+
+static_assert(min_of(3, 5) == 3 && max_of('a', 'b') == 'b', "min_of, max_of are constexpr");
+
+#endif
+
+/*
+  SIMD min/max of an array, with AVX2 when the CPU has it.
+
+  floats are compared as their "order keys": the bits as an int32, with the
+  bits other than the sign flipped when the sign is set.  The keys of floats
+  compare as ints in the order -NaN < -inf < ... < -0.0 < +0.0 < ... < +inf
+  < +NaN, so an int min/max of keys is the float min/max with -0.0 < +0.0.
+  NaNs are replaced with +inf (for min) or -inf (for max), which makes them
+  ignored, as in min_float/max_float.
+
+  The AVX2 versions are only built on x86; elsewhere, such as ARM Macs, the
+  scalar loops are the only path.
+*/
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MINMAX_X86 1
+#include <immintrin.h>
+#endif
+
+static inline int32_t float_key(float x) {
+    int32_t bits;
+    memcpy(&bits, &x, sizeof bits);
+    return bits ^ ((bits >> 31) & 0x7fffffff);
+}
+
+static inline float key_float(int32_t key) {
+    float x;
+    key ^= (key >> 31) & 0x7fffffff;
+    memcpy(&x, &key, sizeof x);
+    return x;
+}
+
+/*
+  Whether the CPU has AVX2, found once before main runs, so that no two
+  threads ever race to find it.
+*/
+#ifdef MINMAX_X86
+static int avx2_supported;
+
+__attribute__((constructor)) static void detect_avx2(void) {
+    __builtin_cpu_init();
+    avx2_supported = __builtin_cpu_supports("avx2") ? 1 : 0;
+}
+
+static int has_avx2(void) {
+    return avx2_supported;
+}
+#else
+static int has_avx2(void) {
+    return 0;
+}
+#endif
+
+#ifdef MINMAX_X86
+
+__attribute__((target("avx2")))
+static int min_array_int_avx2(const int *a, size_t size) {
+    __m256i lo = _mm256_set1_epi32(INT32_MAX);
+    int result;
+    size_t i;
+    for (i = 0; i + 8 <= size; i += 8) {
+        lo = _mm256_min_epi32(lo, _mm256_loadu_si256((const __m256i *) (a + i)));
+    }
+    lo = _mm256_min_epi32(lo, _mm256_permute2x128_si256(lo, lo, 1));
+    lo = _mm256_min_epi32(lo, _mm256_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+    lo = _mm256_min_epi32(lo, _mm256_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+    result = _mm256_cvtsi256_si32(lo);
+    for (; i < size; i++) result = branchless_min_int(result, a[i]);
+    return result;
+}
+
+__attribute__((target("avx2")))
+static int max_array_int_avx2(const int *a, size_t size) {
+    __m256i hi = _mm256_set1_epi32(INT32_MIN);
+    int result;
+    size_t i;
+    for (i = 0; i + 8 <= size; i += 8) {
+        hi = _mm256_max_epi32(hi, _mm256_loadu_si256((const __m256i *) (a + i)));
+    }
+    hi = _mm256_max_epi32(hi, _mm256_permute2x128_si256(hi, hi, 1));
+    hi = _mm256_max_epi32(hi, _mm256_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+    hi = _mm256_max_epi32(hi, _mm256_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+    result = _mm256_cvtsi256_si32(hi);
+    for (; i < size; i++) result = branchless_max_int(result, a[i]);
+    return result;
+}
+
+/* The keys of 8 floats, with NaNs replaced by the key of replacement. */
+__attribute__((target("avx2")))
+static inline __m256i float_keys_avx2(const float *a, __m256i replacement, __m256i *seen) {
+    __m256 x = _mm256_loadu_ps(a);
+    __m256i bits = _mm256_castps_si256(x);
+    __m256i keys = _mm256_xor_si256(bits, _mm256_and_si256(_mm256_srai_epi32(bits, 31), _mm256_set1_epi32(0x7fffffff)));
+    __m256i ordered = _mm256_castps_si256(_mm256_cmp_ps(x, x, _CMP_ORD_Q));
+    *seen = _mm256_or_si256(*seen, ordered);
+    return _mm256_blendv_epi8(replacement, keys, ordered);
+}
+
+__attribute__((target("avx2")))
+static float min_array_float_avx2(const float *a, size_t size) {
+    __m256i lo = _mm256_set1_epi32(float_key(INFINITY));
+    __m256i seen = _mm256_setzero_si256();
+    float result;
+    size_t i;
+    for (i = 0; i + 8 <= size; i += 8) {
+        lo = _mm256_min_epi32(lo, float_keys_avx2(a + i, _mm256_set1_epi32(float_key(INFINITY)), &seen));
+    }
+    lo = _mm256_min_epi32(lo, _mm256_permute2x128_si256(lo, lo, 1));
+    lo = _mm256_min_epi32(lo, _mm256_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+    lo = _mm256_min_epi32(lo, _mm256_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+    result = _mm256_testz_si256(seen, seen) ? NAN : key_float(_mm256_cvtsi256_si32(lo));
+    for (; i < size; i++) result = min_float(result, a[i]);
+    return result;
+}
+
+__attribute__((target("avx2")))
+static float max_array_float_avx2(const float *a, size_t size) {
+    __m256i hi = _mm256_set1_epi32(float_key(-INFINITY));
+    __m256i seen = _mm256_setzero_si256();
+    float result;
+    size_t i;
+    for (i = 0; i + 8 <= size; i += 8) {
+        hi = _mm256_max_epi32(hi, float_keys_avx2(a + i, _mm256_set1_epi32(float_key(-INFINITY)), &seen));
+    }
+    hi = _mm256_max_epi32(hi, _mm256_permute2x128_si256(hi, hi, 1));
+    hi = _mm256_max_epi32(hi, _mm256_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+    hi = _mm256_max_epi32(hi, _mm256_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+    result = _mm256_testz_si256(seen, seen) ? NAN : key_float(_mm256_cvtsi256_si32(hi));
+    for (; i < size; i++) result = max_float(result, a[i]);
+    return result;
+}
+
+#endif  /* MINMAX_X86 */
+
+/* size must be > 0.  The float versions return NaN only if all are NaN. */
+
+int min_array_int(const int *a, size_t size) {
+    int result = a[0];
+    size_t i;
+#ifdef MINMAX_X86
+    if (has_avx2()) return min_array_int_avx2(a, size);
+#endif
+    for (i = 1; i < size; i++) result = branchless_min_int(result, a[i]);
+    return result;
+}
+
+int max_array_int(const int *a, size_t size) {
+    int result = a[0];
+    size_t i;
+#ifdef MINMAX_X86
+    if (has_avx2()) return max_array_int_avx2(a, size);
+#endif
+    for (i = 1; i < size; i++) result = branchless_max_int(result, a[i]);
+    return result;
+}
+
+float min_array_float(const float *a, size_t size) {
+    float result = a[0];
+    size_t i;
+#ifdef MINMAX_X86
+    if (has_avx2()) return min_array_float_avx2(a, size);
+#endif
+    for (i = 1; i < size; i++) result = min_float(result, a[i]);
+    return result;
+}
+
+float max_array_float(const float *a, size_t size) {
+    float result = a[0];
+    size_t i;
+#ifdef MINMAX_X86
+    if (has_avx2()) return max_array_float_avx2(a, size);
+#endif
+    for (i = 1; i < size; i++) result = max_float(result, a[i]);
+    return result;
+}
+
+void test5() {
+    // should print, with any compiler:
+    // test5: 5 9 6 	5 9 6 	-0.0 -0.0 +0.0 +0.0 	+1.0 +1.0 nan 	-3 4 -0.0 +0.0 +2.0
+
+    printf("test5: ");
+
+    int x = 8;
+    int y = 5;
+    printf("%d ", min_int(x++, y++));  // correct. 5
+    printf("%d %d ", x, y);            // correct. 9 6
+    printf("\t");
+    x = 8;
+    y = 5;
+    printf("%d ", MIN_ONCE(x++, y++));  // correct. 5
+    printf("%d %d ", x, y);             // correct. 9 6
+    printf("\t");
+
+    printf("%+1.1f ", min_float(+0.0f, -0.0f));
+    printf("%+1.1f ", min_float(-0.0f, +0.0f));
+    printf("%+1.1f ", max_float(+0.0f, -0.0f));
+    printf("%+1.1f ", max_float(-0.0f, +0.0f));
+    printf("\t");
+
+    printf("%+1.1f ", min_float(NAN, 1.0f));
+    printf("%+1.1f ", max_float(1.0f, NAN));
+    printf("%1.1f ", min_float(NAN, NAN));
+    printf("\t");
+
+    int ints[] = { 3, -1, 4, -1, 0, 2, 0, 1, 1, 4, -3, 2 };  // more than 8, for the SIMD loop
+    float floats[] = { 1, +0.0f, NAN, -0.0f, 2, NAN, 0.5f, 1.5f, +0.0f, -0.0f, NAN };
+    float zeros[] = { +0.0f, -0.0f, +0.0f, NAN, +0.0f, +0.0f, +0.0f, +0.0f, -0.0f };
+    printf("%d ", min_array_int(ints, sizeof(ints) / sizeof(ints[0])));
+    printf("%d ", max_array_int(ints, sizeof(ints) / sizeof(ints[0])));
+    printf("%+1.1f ", min_array_float(zeros, sizeof(zeros) / sizeof(zeros[0])));
+    printf("%+1.1f ", max_array_float(zeros, sizeof(zeros) / sizeof(zeros[0])));
+    printf("%+1.1f ", max_array_float(floats, sizeof(floats) / sizeof(floats[0])));
+
+    printf("\n");
+}
+
+/*
+  Reductions of whole float and double arrays: min, max, minmax, argmin,
+  argmax, and elementwise clamp, with the treatment of NaN and of -0.0 given
+  explicitly by the caller:
+
+  - NAN_IGNORE: NaNs are skipped, as in fminf/fmaxf; NaN only if all are NaN.
+    NAN_PROPAGATE: the result is the first NaN, if there is one.
+  - ZERO_ORDERED: -0.0 < +0.0.
+    ZERO_EQUAL: -0.0 == +0.0, and of equal elements the first one wins.
+
+  Everything is computed on the order keys of the elements (see float_key),
+  as integers, and never with fmin, minps or a compiler's idea of `<' on
+  zeros, so the results are the same with GCC and Clang, with or without
+  AVX2, and with any number of threads.
+
+  argmin/argmax take two passes: the min (max) key, then the first element
+  with that key.  min/max need the second pass only for ZERO_EQUAL when the
+  result is a zero, to find out which zero came first.
+
+  Arrays larger than the L2 cache are split over minmax_threads threads
+  (0, the default, for one per core).  The second pass is not split.
+*/
+
+#include <pthread.h>
+#include <unistd.h>  // sysconf
+
+enum nan_policy { NAN_IGNORE, NAN_PROPAGATE };
+enum zero_policy { ZERO_ORDERED, ZERO_EQUAL };
+
+struct float_minmax { float min, max; };
+struct double_minmax { double min, max; };
+
+unsigned minmax_threads = 0;
+
+static inline int64_t double_key(double x) {
+    int64_t bits;
+    memcpy(&bits, &x, sizeof bits);
+    return bits ^ ((bits >> 63) & INT64_MAX);
+}
+
+static inline double key_double(int64_t key) {
+    double x;
+    key ^= (key >> 63) & INT64_MAX;
+    memcpy(&x, &key, sizeof x);
+    return x;
+}
+
+/* With ZERO_EQUAL, the key of -0.0 (-1, for float and for double) becomes the key of +0.0. */
+static inline int64_t canonical_key(int64_t key, enum zero_policy zero) {
+    return zero == ZERO_EQUAL && key == -1 ? 0 : key;
+}
+
+/* The min and max keys of the numbers in a range, and whether it had NaNs and numbers. */
+struct key_range {
+    int64_t lo, hi;
+    int nans, numbers;
+};
+
+static void merge_key_range(struct key_range *into, const struct key_range *from) {
+    if (from->lo < into->lo) into->lo = from->lo;
+    if (from->hi > into->hi) into->hi = from->hi;
+    into->nans |= from->nans;
+    into->numbers |= from->numbers;
+}
+
+/* Scalar versions, for both types, for CPUs without AVX2 and for the tails. */
+
+#define DEFINE_KEY_FUNCTIONS(type) \
+    static void type##_key_range_scalar(const type *a, size_t first, size_t last, enum zero_policy zero, \
+                                        struct key_range *range) { \
+        for (size_t i = first; i < last; i++) { \
+            if (a[i] != a[i]) { \
+                range->nans = 1; \
+                continue; \
+            } \
+            int64_t key = canonical_key(type##_key(a[i]), zero); \
+            if (key < range->lo) range->lo = key; \
+            if (key > range->hi) range->hi = key; \
+            range->numbers = 1; \
+        } \
+    } \
+    \
+    static size_t type##_find_key_scalar(const type *a, size_t first, size_t last, int64_t key, \
+                                         enum zero_policy zero) { \
+        for (size_t i = first; i < last; i++) { \
+            if (a[i] == a[i] && canonical_key(type##_key(a[i]), zero) == key) return i; \
+        } \
+        return last; \
+    } \
+    \
+    static void type##_clamp_scalar(const type *a, type *out, size_t first, size_t last, type lo, type hi, \
+                                    enum nan_policy nan, enum zero_policy zero) { \
+        int64_t lo_key = canonical_key(type##_key(lo), zero); \
+        int64_t hi_key = canonical_key(type##_key(hi), zero); \
+        for (size_t i = first; i < last; i++) { \
+            int64_t key = canonical_key(type##_key(a[i]), zero); \
+            if (a[i] != a[i]) { \
+                out[i] = nan == NAN_PROPAGATE ? a[i] : lo; \
+            } else { \
+                out[i] = key < lo_key ? lo : key > hi_key ? hi : a[i]; \
+            } \
+        } \
+    }
+
+DEFINE_KEY_FUNCTIONS(float)
+DEFINE_KEY_FUNCTIONS(double)
+
+/*
+  AVX2 versions, on x86.  Lanes with a NaN get the key INT_MAX for lo and
+  INT_MIN for hi.
+*/
+
+#ifdef MINMAX_X86
+
+__attribute__((target("avx2")))
+static void float_key_range_avx2(const float *a, size_t first, size_t last, enum zero_policy zero,
+                                 struct key_range *range) {
+    const __m256i magnitude = _mm256_set1_epi32(0x7fffffff);
+    const __m256i ones = _mm256_set1_epi32(-1);
+    const __m256i canonical = zero == ZERO_EQUAL ? ones : _mm256_setzero_si256();
+    __m256i lo = _mm256_set1_epi32(INT32_MAX);
+    __m256i hi = _mm256_set1_epi32(INT32_MIN);
+    __m256i ordered_lanes = _mm256_setzero_si256();
+    __m256i unordered_lanes = _mm256_setzero_si256();
+    int32_t lanes_lo[8], lanes_hi[8];
+    size_t i;
+    for (i = first; i + 8 <= last; i += 8) {
+        __m256 x = _mm256_loadu_ps(a + i);
+        __m256i bits = _mm256_castps_si256(x);
+        __m256i keys = _mm256_xor_si256(bits, _mm256_and_si256(_mm256_srai_epi32(bits, 31), magnitude));
+        __m256i ordered = _mm256_castps_si256(_mm256_cmp_ps(x, x, _CMP_ORD_Q));
+        keys = _mm256_andnot_si256(_mm256_and_si256(_mm256_cmpeq_epi32(keys, ones), canonical), keys);
+        ordered_lanes = _mm256_or_si256(ordered_lanes, ordered);
+        unordered_lanes = _mm256_or_si256(unordered_lanes, _mm256_xor_si256(ordered, ones));
+        lo = _mm256_min_epi32(lo, _mm256_blendv_epi8(_mm256_set1_epi32(INT32_MAX), keys, ordered));
+        hi = _mm256_max_epi32(hi, _mm256_blendv_epi8(_mm256_set1_epi32(INT32_MIN), keys, ordered));
+    }
+    if (!_mm256_testz_si256(ordered_lanes, ordered_lanes)) {
+        _mm256_storeu_si256((__m256i *) lanes_lo, lo);
+        _mm256_storeu_si256((__m256i *) lanes_hi, hi);
+        for (int lane = 0; lane < 8; lane++) {
+            // Lanes with no numbers still have INT32_MAX, INT32_MIN, which no number has as key.
+            if (lanes_lo[lane] != INT32_MAX && lanes_lo[lane] < range->lo) range->lo = lanes_lo[lane];
+            if (lanes_hi[lane] != INT32_MIN && lanes_hi[lane] > range->hi) range->hi = lanes_hi[lane];
+        }
+        range->numbers = 1;
+    }
+    range->nans |= !_mm256_testz_si256(unordered_lanes, unordered_lanes);
+    float_key_range_scalar(a, i, last, zero, range);
+}
+
+__attribute__((target("avx2")))
+static void double_key_range_avx2(const double *a, size_t first, size_t last, enum zero_policy zero,
+                                  struct key_range *range) {
+    const __m256i magnitude = _mm256_set1_epi64x(INT64_MAX);
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    const __m256i canonical = zero == ZERO_EQUAL ? ones : _mm256_setzero_si256();
+    __m256i lo = _mm256_set1_epi64x(INT64_MAX);
+    __m256i hi = _mm256_set1_epi64x(INT64_MIN);
+    __m256i ordered_lanes = _mm256_setzero_si256();
+    __m256i unordered_lanes = _mm256_setzero_si256();
+    int64_t lanes_lo[4], lanes_hi[4];
+    size_t i;
+    for (i = first; i + 4 <= last; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        __m256i bits = _mm256_castpd_si256(x);
+        __m256i negative = _mm256_cmpgt_epi64(_mm256_setzero_si256(), bits);
+        __m256i keys = _mm256_xor_si256(bits, _mm256_and_si256(negative, magnitude));
+        __m256i ordered = _mm256_castpd_si256(_mm256_cmp_pd(x, x, _CMP_ORD_Q));
+        keys = _mm256_andnot_si256(_mm256_and_si256(_mm256_cmpeq_epi64(keys, ones), canonical), keys);
+        ordered_lanes = _mm256_or_si256(ordered_lanes, ordered);
+        unordered_lanes = _mm256_or_si256(unordered_lanes, _mm256_xor_si256(ordered, ones));
+        __m256i lo_keys = _mm256_blendv_epi8(_mm256_set1_epi64x(INT64_MAX), keys, ordered);
+        __m256i hi_keys = _mm256_blendv_epi8(_mm256_set1_epi64x(INT64_MIN), keys, ordered);
+        lo = _mm256_blendv_epi8(lo, lo_keys, _mm256_cmpgt_epi64(lo, lo_keys));
+        hi = _mm256_blendv_epi8(hi, hi_keys, _mm256_cmpgt_epi64(hi_keys, hi));
+    }
+    if (!_mm256_testz_si256(ordered_lanes, ordered_lanes)) {
+        _mm256_storeu_si256((__m256i *) lanes_lo, lo);
+        _mm256_storeu_si256((__m256i *) lanes_hi, hi);
+        for (int lane = 0; lane < 4; lane++) {
+            if (lanes_lo[lane] != INT64_MAX && lanes_lo[lane] < range->lo) range->lo = lanes_lo[lane];
+            if (lanes_hi[lane] != INT64_MIN && lanes_hi[lane] > range->hi) range->hi = lanes_hi[lane];
+        }
+        range->numbers = 1;
+    }
+    range->nans |= !_mm256_testz_si256(unordered_lanes, unordered_lanes);
+    double_key_range_scalar(a, i, last, zero, range);
+}
+
+__attribute__((target("avx2")))
+static size_t float_find_key_avx2(const float *a, size_t first, size_t last, int64_t key, enum zero_policy zero) {
+    const __m256i magnitude = _mm256_set1_epi32(0x7fffffff);
+    const __m256i ones = _mm256_set1_epi32(-1);
+    const __m256i canonical = zero == ZERO_EQUAL ? ones : _mm256_setzero_si256();
+    const __m256i target = _mm256_set1_epi32((int32_t) key);
+    size_t i;
+    for (i = first; i + 8 <= last; i += 8) {
+        __m256i bits = _mm256_loadu_si256((const __m256i *) (a + i));
+        __m256i keys = _mm256_xor_si256(bits, _mm256_and_si256(_mm256_srai_epi32(bits, 31), magnitude));
+        keys = _mm256_andnot_si256(_mm256_and_si256(_mm256_cmpeq_epi32(keys, ones), canonical), keys);
+        int found = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(keys, target)));
+        if (found != 0) return i + __builtin_ctz(found);
+    }
+    return float_find_key_scalar(a, i, last, key, zero);
+}
+
+__attribute__((target("avx2")))
+static size_t double_find_key_avx2(const double *a, size_t first, size_t last, int64_t key, enum zero_policy zero) {
+    const __m256i magnitude = _mm256_set1_epi64x(INT64_MAX);
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    const __m256i canonical = zero == ZERO_EQUAL ? ones : _mm256_setzero_si256();
+    const __m256i target = _mm256_set1_epi64x(key);
+    size_t i;
+    for (i = first; i + 4 <= last; i += 4) {
+        __m256i bits = _mm256_loadu_si256((const __m256i *) (a + i));
+        __m256i negative = _mm256_cmpgt_epi64(_mm256_setzero_si256(), bits);
+        __m256i keys = _mm256_xor_si256(bits, _mm256_and_si256(negative, magnitude));
+        keys = _mm256_andnot_si256(_mm256_and_si256(_mm256_cmpeq_epi64(keys, ones), canonical), keys);
+        int found = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(keys, target)));
+        if (found != 0) return i + __builtin_ctz(found);
+    }
+    return double_find_key_scalar(a, i, last, key, zero);
+}
+
+__attribute__((target("avx2")))
+static void float_clamp_avx2(const float *a, float *out, size_t first, size_t last, float lo, float hi,
+                             enum nan_policy nan, enum zero_policy zero) {
+    const __m256i magnitude = _mm256_set1_epi32(0x7fffffff);
+    const __m256i ones = _mm256_set1_epi32(-1);
+    const __m256i canonical = zero == ZERO_EQUAL ? ones : _mm256_setzero_si256();
+    const __m256i lo_key = _mm256_set1_epi32((int32_t) canonical_key(float_key(lo), zero));
+    const __m256i hi_key = _mm256_set1_epi32((int32_t) canonical_key(float_key(hi), zero));
+    const __m256 nan_result = _mm256_set1_ps(lo);
+    const __m256 propagate = _mm256_castsi256_ps(nan == NAN_PROPAGATE ? ones : _mm256_setzero_si256());
+    size_t i;
+    for (i = first; i + 8 <= last; i += 8) {
+        __m256 x = _mm256_loadu_ps(a + i);
+        __m256i bits = _mm256_castps_si256(x);
+        __m256i keys = _mm256_xor_si256(bits, _mm256_and_si256(_mm256_srai_epi32(bits, 31), magnitude));
+        keys = _mm256_andnot_si256(_mm256_and_si256(_mm256_cmpeq_epi32(keys, ones), canonical), keys);
+        __m256 unordered = _mm256_cmp_ps(x, x, _CMP_UNORD_Q);
+        __m256 below = _mm256_castsi256_ps(_mm256_cmpgt_epi32(lo_key, keys));
+        __m256 above = _mm256_castsi256_ps(_mm256_cmpgt_epi32(keys, hi_key));
+        __m256 y = _mm256_blendv_ps(x, _mm256_set1_ps(lo), below);
+        y = _mm256_blendv_ps(y, _mm256_set1_ps(hi), above);
+        // NaNs: the NaN itself (not a canonical one) when propagating, else lo.
+        y = _mm256_blendv_ps(y, _mm256_blendv_ps(nan_result, x, propagate), unordered);
+        _mm256_storeu_ps(out + i, y);
+    }
+    float_clamp_scalar(a, out, i, last, lo, hi, nan, zero);
+}
+
+__attribute__((target("avx2")))
+static void double_clamp_avx2(const double *a, double *out, size_t first, size_t last, double lo, double hi,
+                              enum nan_policy nan, enum zero_policy zero) {
+    const __m256i magnitude = _mm256_set1_epi64x(INT64_MAX);
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    const __m256i canonical = zero == ZERO_EQUAL ? ones : _mm256_setzero_si256();
+    const __m256i lo_key = _mm256_set1_epi64x(canonical_key(double_key(lo), zero));
+    const __m256i hi_key = _mm256_set1_epi64x(canonical_key(double_key(hi), zero));
+    const __m256d nan_result = _mm256_set1_pd(lo);
+    const __m256d propagate = _mm256_castsi256_pd(nan == NAN_PROPAGATE ? ones : _mm256_setzero_si256());
+    size_t i;
+    for (i = first; i + 4 <= last; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        __m256i bits = _mm256_castpd_si256(x);
+        __m256i negative = _mm256_cmpgt_epi64(_mm256_setzero_si256(), bits);
+        __m256i keys = _mm256_xor_si256(bits, _mm256_and_si256(negative, magnitude));
+        keys = _mm256_andnot_si256(_mm256_and_si256(_mm256_cmpeq_epi64(keys, ones), canonical), keys);
+        __m256d unordered = _mm256_cmp_pd(x, x, _CMP_UNORD_Q);
+        __m256d below = _mm256_castsi256_pd(_mm256_cmpgt_epi64(lo_key, keys));
+        __m256d above = _mm256_castsi256_pd(_mm256_cmpgt_epi64(keys, hi_key));
+        __m256d y = _mm256_blendv_pd(x, _mm256_set1_pd(lo), below);
+        y = _mm256_blendv_pd(y, _mm256_set1_pd(hi), above);
+        y = _mm256_blendv_pd(y, _mm256_blendv_pd(nan_result, x, propagate), unordered);
+        _mm256_storeu_pd(out + i, y);
+    }
+    double_clamp_scalar(a, out, i, last, lo, hi, nan, zero);
+}
+
+/* name##_avx2 if avx2 is set, else name##_scalar; always the scalar one off x86. */
+#define AVX2_OR_SCALAR(avx2, name) ((avx2) ? name##_avx2 : name##_scalar)
+
+#else
+
+#define AVX2_OR_SCALAR(avx2, name) name##_scalar
+
+#endif  /* MINMAX_X86 */
+
+/*
+  Running the first pass, or clamp, in chunks on threads.  A job is one
+  call over [0, size), and each chunk writes its own key_range.
+*/
+
+#define MAX_MINMAX_THREADS 64
+
+enum array_operation { ARRAY_KEY_RANGE, ARRAY_CLAMP };
+
+struct array_job {
+    enum array_operation operation;
+    int is_double;
+    const void *input;
+    void *output;
+    double lo, hi;
+    enum nan_policy nan;
+    enum zero_policy zero;
+    int avx2;  /* has_avx2(), found before the threads start */
+    struct key_range ranges[MAX_MINMAX_THREADS];
+};
+
+struct array_chunk {
+    struct array_job *job;
+    size_t first, last;
+    unsigned index;
+};
+
+static void *run_array_chunk(void *arg) {
+    struct array_chunk *chunk = (struct array_chunk *) arg;
+    struct array_job *job = chunk->job;
+    struct key_range *range = &job->ranges[chunk->index];
+    range->lo = INT64_MAX;
+    range->hi = INT64_MIN;
+    range->nans = range->numbers = 0;
+    if (job->operation == ARRAY_KEY_RANGE && job->is_double) {
+        AVX2_OR_SCALAR(job->avx2, double_key_range)(
+            (const double *) job->input, chunk->first, chunk->last, job->zero, range);
+    } else if (job->operation == ARRAY_KEY_RANGE) {
+        AVX2_OR_SCALAR(job->avx2, float_key_range)(
+            (const float *) job->input, chunk->first, chunk->last, job->zero, range);
+    } else if (job->is_double) {
+        AVX2_OR_SCALAR(job->avx2, double_clamp)(
+            (const double *) job->input, (double *) job->output, chunk->first, chunk->last,
+            job->lo, job->hi, job->nan, job->zero);
+    } else {
+        AVX2_OR_SCALAR(job->avx2, float_clamp)(
+            (const float *) job->input, (float *) job->output, chunk->first, chunk->last,
+            (float) job->lo, (float) job->hi, job->nan, job->zero);
+    }
+    return NULL;
+}
+
+/* The size of the L2 cache is a glibc extension of sysconf; 1 MB where it is not there. */
+static size_t l2_cache_bytes(void) {
+    long bytes = -1;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    return bytes > 0 ? (size_t) bytes : 1 << 20;
+}
+
+/* Runs the job, and returns the merged key_range of its chunks. */
+static struct key_range run_array_job(struct array_job *job, size_t size, size_t element_size) {
+    struct array_chunk chunks[MAX_MINMAX_THREADS];
+    pthread_t threads[MAX_MINMAX_THREADS];
+    unsigned count = 1;
+    job->avx2 = has_avx2();
+    if (size * element_size > l2_cache_bytes()) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        count = minmax_threads != 0 ? minmax_threads : cores > 0 ? (unsigned) cores : 1;
+        if (count > MAX_MINMAX_THREADS) count = MAX_MINMAX_THREADS;
+    }
+    size_t first = 0;
+    for (unsigned t = 0; t < count; t++) {
+        size_t chunk_size = size / count + (t < size % count ? 1 : 0);
+        chunks[t].job = job;
+        chunks[t].first = first;
+        chunks[t].last = first + chunk_size;
+        chunks[t].index = t;
+        first += chunk_size;
+        // The calling thread runs the last chunk; if a thread can't be created, it runs that one too.
+        if (t + 1 == count || pthread_create(&threads[t], NULL, run_array_chunk, &chunks[t]) != 0) {
+            run_array_chunk(&chunks[t]);
+            threads[t] = pthread_self();
+        }
+    }
+    for (unsigned t = 0; t < count; t++) {
+        if (!pthread_equal(threads[t], pthread_self())) pthread_join(threads[t], NULL);
+    }
+    struct key_range range = job->ranges[0];
+    for (unsigned t = 1; t < count; t++) merge_key_range(&range, &job->ranges[t]);
+    return range;
+}
+
+/*
+  The public functions, for float and for double.  For an empty array,
+  min/max are NaN and argmin/argmax are 0 == size.  If all are NaN, the
+  results are the first NaN, with either policy.
+*/
+
+#define DEFINE_ARRAY_REDUCTIONS(type, is_double_type) \
+    static struct key_range type##_array_key_range(const type *a, size_t size, enum zero_policy zero) { \
+        struct array_job job; \
+        job.operation = ARRAY_KEY_RANGE; \
+        job.is_double = is_double_type; \
+        job.input = a; \
+        job.zero = zero; \
+        return run_array_job(&job, size, sizeof(type)); \
+    } \
+    \
+    static size_t type##_find_key(const type *a, size_t size, int64_t key, enum zero_policy zero) { \
+        return AVX2_OR_SCALAR(has_avx2(), type##_find_key)(a, 0, size, key, zero); \
+    } \
+    \
+    static size_t type##_first_nan(const type *a, size_t size) { \
+        size_t i = 0; \
+        while (i < size && a[i] == a[i]) i++; \
+        return i; \
+    } \
+    \
+    /* The index of the element with the given key of range, or of the first NaN. */ \
+    static size_t type##_array_index(const type *a, size_t size, const struct key_range *range, int64_t key, \
+                                     enum nan_policy nan, enum zero_policy zero) { \
+        if (!range->numbers || (range->nans && nan == NAN_PROPAGATE)) return type##_first_nan(a, size); \
+        return type##_find_key(a, size, key, zero); \
+    } \
+    \
+    /* The element with the given key: found again only if needed. */ \
+    static type type##_array_value(const type *a, size_t size, const struct key_range *range, int64_t key, \
+                                   enum nan_policy nan, enum zero_policy zero) { \
+        if (size == 0) return NAN; \
+        if (range->numbers && !(range->nans && nan == NAN_PROPAGATE) && !(zero == ZERO_EQUAL && key == 0)) { \
+            return key_##type(key); \
+        } \
+        return a[type##_array_index(a, size, range, key, nan, zero)]; \
+    } \
+    \
+    type type##_array_min(const type *a, size_t size, enum nan_policy nan, enum zero_policy zero) { \
+        struct key_range range = type##_array_key_range(a, size, zero); \
+        return type##_array_value(a, size, &range, range.lo, nan, zero); \
+    } \
+    \
+    type type##_array_max(const type *a, size_t size, enum nan_policy nan, enum zero_policy zero) { \
+        struct key_range range = type##_array_key_range(a, size, zero); \
+        return type##_array_value(a, size, &range, range.hi, nan, zero); \
+    } \
+    \
+    struct type##_minmax type##_array_minmax(const type *a, size_t size, enum nan_policy nan, enum zero_policy zero) { \
+        struct key_range range = type##_array_key_range(a, size, zero); \
+        struct type##_minmax result; \
+        result.min = type##_array_value(a, size, &range, range.lo, nan, zero); \
+        result.max = type##_array_value(a, size, &range, range.hi, nan, zero); \
+        return result; \
+    } \
+    \
+    size_t type##_array_argmin(const type *a, size_t size, enum nan_policy nan, enum zero_policy zero) { \
+        struct key_range range = type##_array_key_range(a, size, zero); \
+        return size == 0 ? 0 : type##_array_index(a, size, &range, range.lo, nan, zero); \
+    } \
+    \
+    size_t type##_array_argmax(const type *a, size_t size, enum nan_policy nan, enum zero_policy zero) { \
+        struct key_range range = type##_array_key_range(a, size, zero); \
+        return size == 0 ? 0 : type##_array_index(a, size, &range, range.hi, nan, zero); \
+    } \
+    \
+    /* out[i] = a[i] clamped to [lo, hi], which must be numbers with lo <= hi.  out may be a. */ \
+    void type##_array_clamp(const type *a, type *out, size_t size, type lo, type hi, \
+                            enum nan_policy nan, enum zero_policy zero) { \
+        struct array_job job; \
+        job.operation = ARRAY_CLAMP; \
+        job.is_double = is_double_type; \
+        job.input = a; \
+        job.output = out; \
+        job.lo = lo; \
+        job.hi = hi; \
+        job.nan = nan; \
+        job.zero = zero; \
+        run_array_job(&job, size, sizeof(type)); \
+    }
+
+DEFINE_ARRAY_REDUCTIONS(float, 0)
+DEFINE_ARRAY_REDUCTIONS(double, 1)
+
+void test6() {
+    // should print, with any compiler:
+    // test6: -0.0 +0.0 2 1 	-0.0 nan 1 2 3 	-1.0 +2.0 -1.0 -0.0 -0.0 +0.0 -1.0 +1.0 +2.0 nan 	nan 0 nan
+
+    printf("test6: ");
+
+    // More than 8 elements, for the AVX2 loops, with zeros of both signs.
+    float zeros[] = { 1, +0.0f, -0.0f, 2, 3, +0.0f, 4, 5, -0.0f, 6 };
+    size_t size = sizeof(zeros) / sizeof(zeros[0]);
+    printf("%+1.1f ", float_array_min(zeros, size, NAN_IGNORE, ZERO_ORDERED));  // -0.0 < +0.0
+    printf("%+1.1f ", float_array_min(zeros, size, NAN_IGNORE, ZERO_EQUAL));    // the first zero
+    printf("%lu ", (unsigned long) float_array_argmin(zeros, size, NAN_IGNORE, ZERO_ORDERED));
+    printf("%lu ", (unsigned long) float_array_argmin(zeros, size, NAN_IGNORE, ZERO_EQUAL));
+    printf("\t");
+
+    double doubles[] = { 0.5, -0.0, NAN, 2, -0.0, 1, NAN, +0.0, 2, 0.25 };
+    size = sizeof(doubles) / sizeof(doubles[0]);
+    printf("%+1.1f ", double_array_min(doubles, size, NAN_IGNORE, ZERO_ORDERED));
+    printf("%1.1f ", double_array_min(doubles, size, NAN_PROPAGATE, ZERO_ORDERED));
+    printf("%lu ", (unsigned long) double_array_argmin(doubles, size, NAN_IGNORE, ZERO_ORDERED));
+    printf("%lu ", (unsigned long) double_array_argmin(doubles, size, NAN_PROPAGATE, ZERO_ORDERED));
+    printf("%lu ", (unsigned long) double_array_argmax(doubles, size, NAN_IGNORE, ZERO_EQUAL));
+    printf("\t");
+
+    float values[] = { -3, 2.5f, NAN, -0.0f, -0.0f, +0.0f, -1, 1, 7 };
+    float clamped[10];
+    float_array_clamp(values, clamped, 9, -1.0f, 2.0f, NAN_IGNORE, ZERO_ORDERED);       // NaN becomes lo
+    float_array_clamp(values + 3, clamped + 3, 3, +0.0f, 2.0f, NAN_IGNORE, ZERO_EQUAL);  // -0.0 is not < +0.0
+    float_array_clamp(values + 2, clamped + 9, 1, -1.0f, 2.0f, NAN_PROPAGATE, ZERO_ORDERED);
+    for (int i = 0; i < 9; i++) printf("%+1.1f ", clamped[i]);
+    printf("%1.1f ", clamped[9]);
+    printf("\t");
+
+    printf("%1.1f ", float_array_min(values, 0, NAN_IGNORE, ZERO_ORDERED));
+    printf("%lu ", (unsigned long) float_array_argmax(values, 0, NAN_IGNORE, ZERO_ORDERED));
+    printf("%1.1f ", float_array_max(values + 2, 1, NAN_IGNORE, ZERO_ORDERED));
+
+    printf("\n");
+}
+
+void benchmark_minmax();
+void benchmark_array_reductions();
+
 int main() {
 
     test1();
     test2();
     test3();
     test4();
+    test5();
+    test6();
+
+    benchmark_minmax();
+    benchmark_array_reductions();
 
     return 0;
 }
+
+/*
+  Benchmark: the min of 16M ints and of 16M floats, with each variant,
+  on random data and on sorted (descending, so that the min changes at every
+  element) data.  The reductions are in noinline functions, so that each is
+  compiled on its own.
+*/
+
+#include <time.h>
+
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+
+static double seconds_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+__attribute__((noinline)) static int min_by_macro(const int *a, size_t size) {
+    int result = a[0];
+    for (size_t i = 1; i < size; i++) result = MIN(result, a[i]);
+    return result;
+}
+
+__attribute__((noinline)) static int min_by_branch(const int *a, size_t size) {
+    int result = a[0];
+    for (size_t i = 1; i < size; i++) {
+        if (a[i] < result) result = a[i];
+        __asm__("" : "+r"(result));  // keep it a loop of branches, not vectorized
+    }
+    return result;
+}
+
+__attribute__((noinline)) static int min_by_function(const int *a, size_t size) {
+    int result = a[0];
+    for (size_t i = 1; i < size; i++) result = min_int(result, a[i]);
+    return result;
+}
+
+__attribute__((noinline)) static int min_by_bit_hack(const int *a, size_t size) {
+    int result = a[0];
+    for (size_t i = 1; i < size; i++) result = branchless_min_int(result, a[i]);
+    return result;
+}
+
+__attribute__((noinline)) static float min_float_by_macro(const float *a, size_t size) {
+    float result = a[0];
+    for (size_t i = 1; i < size; i++) result = MIN(result, a[i]);
+    return result;
+}
+
+__attribute__((noinline)) static float min_float_by_fminf(const float *a, size_t size) {
+    float result = a[0];
+    for (size_t i = 1; i < size; i++) result = fminf(result, a[i]);
+    return result;
+}
+
+__attribute__((noinline)) static float min_float_by_function(const float *a, size_t size) {
+    float result = a[0];
+    for (size_t i = 1; i < size; i++) result = min_float(result, a[i]);
+    return result;
+}
+
+typedef int (*int_reduction)(const int *, size_t);
+typedef float (*float_reduction)(const float *, size_t);
+
+void benchmark_minmax() {
+    const size_t size = 1 << 24;
+    int *ints = (int *) malloc(size * sizeof(int));
+    float *floats = (float *) malloc(size * sizeof(float));
+    const char *int_names[] = { "MIN macro", "if (a[i] < min)", "min_int", "branchless_min_int", "min_array_int" };
+    int_reduction int_reductions[] = { min_by_macro, min_by_branch, min_by_function, min_by_bit_hack, min_array_int };
+    const char *float_names[] = { "MIN macro", "fminf", "min_float", "min_array_float" };
+    float_reduction float_reductions[] = { min_float_by_macro, min_float_by_fminf, min_float_by_function, min_array_float };
+    uint64_t random = 88172645463325252ull;
+
+    if (ints == NULL || floats == NULL) {
+        printf("benchmark_minmax: out of memory\n");
+        free(ints);
+        free(floats);
+        return;
+    }
+
+    printf("\nbenchmark_minmax: min of %lu elements, ns/element\n", (unsigned long) size);
+    for (int sorted = 0; sorted <= 1; sorted++) {
+        for (size_t i = 0; i < size; i++) {
+            random ^= random << 13;
+            random ^= random >> 7;
+            random ^= random << 17;
+            ints[i] = sorted ? (int) (size - i) : (int) (random >> 33);
+            floats[i] = (float) ints[i] * 0.5f;
+        }
+        printf("%s data:\n", sorted ? "sorted" : "random");
+        for (size_t k = 0; k < sizeof(int_reductions) / sizeof(int_reductions[0]); k++) {
+            double start = seconds_now();
+            int result = int_reductions[k](ints, size);
+            double seconds = seconds_now() - start;
+            printf("  %-20s %.3f  (%d)\n", int_names[k], seconds / size * 1e9, result);
+        }
+        for (size_t k = 0; k < sizeof(float_reductions) / sizeof(float_reductions[0]); k++) {
+            double start = seconds_now();
+            float result = float_reductions[k](floats, size);
+            double seconds = seconds_now() - start;
+            printf("  %-20s %.3f  (%.1f)\n", float_names[k], seconds / size * 1e9, result);
+        }
+    }
+
+    free(ints);
+    free(floats);
+}
+
+/*
+  Benchmark: the array reductions of 32M floats and 16M doubles (128 MB,
+  larger than the L2 and L3 caches), against loops of fminf/fmaxf and fmin,
+  with 1 thread and with one per core.
+*/
+
+__attribute__((noinline)) static float fminf_loop(const float *a, size_t size) {
+    float result = a[0];
+    for (size_t i = 1; i < size; i++) result = fminf(result, a[i]);
+    return result;
+}
+
+__attribute__((noinline)) static float fmaxf_loop(const float *a, size_t size) {
+    float result = a[0];
+    for (size_t i = 1; i < size; i++) result = fmaxf(result, a[i]);
+    return result;
+}
+
+__attribute__((noinline)) static double fmin_loop(const double *a, size_t size) {
+    double result = a[0];
+    for (size_t i = 1; i < size; i++) result = fmin(result, a[i]);
+    return result;
+}
+
+__attribute__((noinline)) static size_t argmin_loop(const float *a, size_t size) {
+    size_t result = 0;
+    for (size_t i = 1; i < size; i++) {
+        if (fminf(a[result], a[i]) != a[result]) result = i;
+    }
+    return result;
+}
+
+__attribute__((noinline)) static void fminf_fmaxf_clamp(const float *a, float *out, size_t size, float lo, float hi) {
+    for (size_t i = 0; i < size; i++) out[i] = fminf(fmaxf(a[i], lo), hi);
+}
+
+void benchmark_array_reductions() {
+    const size_t size = 1 << 25;
+    float *floats = (float *) malloc(size * sizeof(float));
+    float *clamped = (float *) malloc(size * sizeof(float));
+    double *doubles = (double *) malloc(size / 2 * sizeof(double));
+    uint64_t random = 88172645463325252ull;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    double start;
+
+    if (floats == NULL || clamped == NULL || doubles == NULL) {
+        printf("benchmark_array_reductions: out of memory\n");
+        free(floats);
+        free(clamped);
+        free(doubles);
+        return;
+    }
+    for (size_t i = 0; i < size; i++) {
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
+        floats[i] = (float) (int32_t) (random >> 32) / 1048576.0f;  /* 2^20 */
+        if (i < size / 2) doubles[i] = (double) (int64_t) random / 1099511627776.0;  /* 2^40 */
+    }
+
+    printf("\nbenchmark_array_reductions: %lu floats, %lu doubles, L2 %lu KB, ns/element\n",
+           (unsigned long) size, (unsigned long) size / 2, (unsigned long) l2_cache_bytes() / 1024);
+
+    start = seconds_now();
+    float f = fminf_loop(floats, size);
+    printf("  fminf loop                 %.3f  (%g)\n", (seconds_now() - start) / size * 1e9, f);
+    start = seconds_now();
+    f = fmaxf_loop(floats, size);
+    printf("  fmaxf loop                 %.3f  (%g)\n", (seconds_now() - start) / size * 1e9, f);
+    start = seconds_now();
+    size_t index = argmin_loop(floats, size);
+    printf("  argmin loop with fminf     %.3f  (%lu)\n", (seconds_now() - start) / size * 1e9, (unsigned long) index);
+    start = seconds_now();
+    fminf_fmaxf_clamp(floats, clamped, size, -100.0f, 100.0f);
+    printf("  fminf(fmaxf()) clamp       %.3f\n", (seconds_now() - start) / size * 1e9);
+    start = seconds_now();
+    double d = fmin_loop(doubles, size / 2);
+    printf("  fmin loop, doubles         %.3f  (%g)\n", (seconds_now() - start) / (size / 2) * 1e9, d);
+
+    unsigned thread_counts[] = { 1, cores > 1 ? (unsigned) cores : 1 };
+    for (int k = 0; k < (thread_counts[1] > 1 ? 2 : 1); k++) {
+        minmax_threads = thread_counts[k];
+        printf(" %u thread(s):\n", minmax_threads);
+        start = seconds_now();
+        f = float_array_min(floats, size, NAN_IGNORE, ZERO_ORDERED);
+        printf("  float_array_min            %.3f  (%g)\n", (seconds_now() - start) / size * 1e9, f);
+        start = seconds_now();
+        struct float_minmax range = float_array_minmax(floats, size, NAN_PROPAGATE, ZERO_EQUAL);
+        printf("  float_array_minmax         %.3f  (%g %g)\n", (seconds_now() - start) / size * 1e9,
+               range.min, range.max);
+        start = seconds_now();
+        index = float_array_argmin(floats, size, NAN_IGNORE, ZERO_ORDERED);
+        printf("  float_array_argmin         %.3f  (%lu)\n", (seconds_now() - start) / size * 1e9,
+               (unsigned long) index);
+        start = seconds_now();
+        float_array_clamp(floats, clamped, size, -100.0f, 100.0f, NAN_IGNORE, ZERO_ORDERED);
+        printf("  float_array_clamp          %.3f\n", (seconds_now() - start) / size * 1e9);
+        start = seconds_now();
+        d = double_array_min(doubles, size / 2, NAN_IGNORE, ZERO_ORDERED);
+        printf("  double_array_min           %.3f  (%g)\n", (seconds_now() - start) / (size / 2) * 1e9, d);
+    }
+    minmax_threads = 0;
+
+    free(floats);
+    free(clamped);
+    free(doubles);
+}
@@ -1,17 +1,108 @@
 /*
   Little snippets of use of std::tuple, along with std::get<n> and std::tie.
   Use -std=c++14 or c++11 to compile, if it is not already the default.
+
+  Also a runtime-dispatched SIMD MinMax for large arrays.  The kernels use
+  GCC/Clang vector extensions and target attributes, so compile with
+  GCC or Clang on x86-64, with optimization on for the benchmark:
+      g++ -std=c++14 -O2 -Wall tuple.cpp -o tuple.out && ./tuple.out
 */
 #include <iostream>
 #include <vector>
 #include <tuple> // In Apple LLVM Clang, tuple is already included in iostream.
                  // But not so in GCC 7.
+#include <cstdint>
+#include <algorithm>  // min, max, minmax_element, sort
 
 std::tuple<int, int> MinMax(std::vector<int> vector);
+template <class T> std::tuple<T, T> MinMax(const T* first, const T* last);
+void BenchmarkMinMax();
 
 struct Node;
 Node* InsertInBST(Node* root, int value);
 std::tuple<int, int> MinMaxBST(Node* root);
+bool ContainsInBST(Node* root, int value);
+void FreeBST(Node* root);
+
+// The same BST, but with all nodes in one arena: a std::vector<ArenaNode>.
+//
+// Nodes link to each other by 32-bit index into the arena instead of by
+// pointer, so a node is 12 bytes instead of 24 (plus malloc's own header),
+// and nodes inserted together sit together in memory.  There is no per-node
+// new/delete; the whole tree is freed at once when the vector goes away,
+// or explicitly with Clear().  Up to 2^32 - 1 nodes.
+
+struct ArenaNode {
+    int value;
+    uint32_t left;
+    uint32_t right;
+};
+
+struct ArenaBST {
+    static constexpr uint32_t nil = UINT32_MAX;
+
+    std::vector<ArenaNode> nodes;
+    uint32_t root = nil;
+
+    void Reserve(size_t size) { nodes.reserve(size); }
+    void Clear() { std::vector<ArenaNode>().swap(nodes); root = nil; }
+    size_t Size() const { return nodes.size(); }
+};
+
+void InsertInBST(ArenaBST& tree, int value);
+bool ContainsInBST(const ArenaBST& tree, int value);
+std::tuple<int, int> MinMaxBST(const ArenaBST& tree);
+void BenchmarkBST();
+
+// A self-balancing (AVL) arena BST, that also caches its min and max.
+// Insert keeps it balanced even for sorted input, so every walk is O(log n);
+// BulkLoadBST builds a perfectly balanced one from a sorted range in O(n).
+
+struct AVLNode {
+    int value;
+    uint32_t left;
+    uint32_t right;
+    int32_t height;  // of the subtree rooted here; a leaf has height 1
+};
+
+struct BalancedBST {
+    static constexpr uint32_t nil = UINT32_MAX;
+
+    std::vector<AVLNode> nodes;
+    uint32_t root = nil;
+    int min = 0;  // cached; valid if root != nil
+    int max = 0;
+
+    void Reserve(size_t size) { nodes.reserve(size); }
+    void Clear() { std::vector<AVLNode>().swap(nodes); root = nil; }
+    size_t Size() const { return nodes.size(); }
+};
+
+void InsertInBST(BalancedBST& tree, int value);
+BalancedBST BulkLoadBST(const int* first, const int* last);
+bool ContainsInBST(const BalancedBST& tree, int value);
+std::tuple<int, int> MinMaxBST(const BalancedBST& tree);
+void BenchmarkBalancedBST();
+
+// A static, read-only search index over the key set of a BST, frozen into
+// one array in Eytzinger (BFS) order: keys[1] is the root, keys[2k] and
+// keys[2k + 1] the children of keys[k].  The top levels of the implicit tree
+// share a few cache lines, and a lookup can prefetch its great-grandchildren,
+// which sit next to each other, long before it needs them.
+
+struct EytzingerIndex {
+    std::vector<int> keys;  // 1-based; keys[0] is unused
+    size_t Size() const { return keys.size() - 1; }
+};
+
+EytzingerIndex BuildIndex(Node* root);
+template <class ArenaTree> EytzingerIndex BuildIndex(const ArenaTree& tree);
+EytzingerIndex BuildIndex(const int* sorted_first, const int* sorted_last);
+const int* LowerBoundInIndex(const EytzingerIndex& index, int value);
+const int* UpperBoundInIndex(const EytzingerIndex& index, int value);
+bool ContainsInIndex(const EytzingerIndex& index, int value);
+void LowerBoundInIndex(const EytzingerIndex& index, const int* values, size_t count, const int** results);
+void BenchmarkIndex();
 
 int main() {
 
@@ -22,6 +113,10 @@ int main() {
     auto minmax = MinMax(vec);
     std::cout << "min(vec) = " << std::get<0>(minmax) << ", max(vec) = " << std::get<1>(minmax) << std::endl;
 
+    // same, without copying the vector, using the SIMD kernel
+    minmax = MinMax(vec.data(), vec.data() + vec.size());
+    std::cout << "min(vec) = " << std::get<0>(minmax) << ", max(vec) = " << std::get<1>(minmax) << std::endl;
+
     // make a BST, take its min-max
 
     Node* bst = nullptr;
@@ -30,6 +125,48 @@ int main() {
     int min, max;
     std::tie(min, max) = MinMaxBST(bst);
     std::cout << "min(bst) = " << min << ", max(bst) = " << max << std::endl;
+    FreeBST(bst);
+
+    // same, with the nodes in an arena
+
+    ArenaBST arenabst;
+    for (auto x : vec) InsertInBST(arenabst, x);
+
+    std::tie(min, max) = MinMaxBST(arenabst);
+    std::cout << "min(arenabst) = " << min << ", max(arenabst) = " << max << std::endl;
+
+    // same, balanced, and bulk-loaded from the sorted vector
+
+    BalancedBST balancedbst;
+    for (auto x : vec) InsertInBST(balancedbst, x);
+
+    std::tie(min, max) = MinMaxBST(balancedbst);
+    std::cout << "min(balancedbst) = " << min << ", max(balancedbst) = " << max << std::endl;
+
+    auto sorted = vec;
+    std::sort(sorted.begin(), sorted.end());
+    auto bulkbst = BulkLoadBST(sorted.data(), sorted.data() + sorted.size());
+
+    std::tie(min, max) = MinMaxBST(bulkbst);
+    std::cout << "min(bulkbst) = " << min << ", max(bulkbst) = " << max << std::endl;
+
+    // freeze the key set of a BST into a search index
+
+    auto index = BuildIndex(balancedbst);
+    std::cout << "index of balancedbst = { ";
+    for (size_t k = 1; k <= index.Size(); k++) std::cout << index.keys[k] << " ";
+    std::cout << "}" << std::endl;
+    std::cout << "contains 4: " << ContainsInIndex(index, 4)
+              << ", contains 5: " << ContainsInIndex(index, 5)
+              << ", lower_bound(5) = " << *LowerBoundInIndex(index, 5)
+              << ", upper_bound(2) = " << *UpperBoundInIndex(index, 2)
+              << ", upper_bound(9) is end: " << (UpperBoundInIndex(index, 9) == nullptr) << std::endl;
+    std::cout << std::endl;
+
+    BenchmarkMinMax();
+    BenchmarkBST();
+    BenchmarkBalancedBST();
+    BenchmarkIndex();
 
     return 0;
 }
@@ -49,6 +186,139 @@ std::tuple<int, int> MinMax(std::vector<int> vector) {
     return { min, max };
 }
 
+// -----------------------------------------------------------------------------
+// MinMax over a contiguous range [first, last), for int, int64_t, float, double.
+//
+// Unlike MinMax(std::vector<int>) above, it does not copy its input, and it
+// compares a whole vector register of elements per step.  The kernel is
+// picked once per element type at runtime, using CPUID via
+// __builtin_cpu_supports: AVX2 (32-byte vectors), SSE4.1 (16-byte vectors),
+// or the plain scalar loop.
+//
+// The vector kernel is written once with GCC/Clang vector extensions, and is
+// inlined into thin wrappers compiled with different target attributes.  So
+// `a < b ? a : b` becomes vpminsd, pminsd, minps, vpcmpgtq + blend etc.
+// For floating point, the result is unspecified if the range contains NaN,
+// same as with the std::min/std::max loop.
+//
+// The target attributes and __builtin_cpu_supports are for x86 only.
+// Elsewhere, such as on ARM Macs, the kernel is the 16-byte vector one,
+// compiled for the baseline of the target (NEON on arm64).
+
+#include <cstring>    // memcpy
+#include <type_traits>  // is_same, is_floating_point
+
+template <class T>
+std::tuple<T, T> MinMaxScalar(const T* first, const T* last) {
+    if (first == last) return { 0, 0 };
+
+    auto min = *first;
+    auto max = *first;
+
+    for (auto p = first + 1; p != last; p++) {
+        min = std::min(min, *p);
+        max = std::max(max, *p);
+    }
+
+    return { min, max };
+}
+
+template <class T, int VectorBytes>
+inline __attribute__((always_inline))
+std::tuple<T, T> MinMaxVector(const T* first, const T* last) {
+    typedef T V __attribute__((vector_size(VectorBytes)));
+    constexpr std::ptrdiff_t lanes = VectorBytes / sizeof(T);
+
+    if (last - first < 2 * lanes) return MinMaxScalar(first, last);
+
+    // Two independent accumulators each, to hide the latency of min/max.
+    V min0, min1, v;
+    std::memcpy(&min0, first, sizeof(V));
+    std::memcpy(&min1, first + lanes, sizeof(V));
+    V max0 = min0;
+    V max1 = min1;
+
+    auto p = first + 2 * lanes;
+    for (; last - p >= 2 * lanes; p += 2 * lanes) {
+        std::memcpy(&v, p, sizeof(V));
+        min0 = v < min0 ? v : min0;
+        max0 = v > max0 ? v : max0;
+        std::memcpy(&v, p + lanes, sizeof(V));
+        min1 = v < min1 ? v : min1;
+        max1 = v > max1 ? v : max1;
+    }
+    // The tail is covered by overlapping loads of the last two vectors.
+    // Looking at an element twice doesn't change a min or a max.
+    std::memcpy(&v, last - 2 * lanes, sizeof(V));
+    min0 = v < min0 ? v : min0;
+    max0 = v > max0 ? v : max0;
+    std::memcpy(&v, last - lanes, sizeof(V));
+    min1 = v < min1 ? v : min1;
+    max1 = v > max1 ? v : max1;
+
+    min0 = min1 < min0 ? min1 : min0;
+    max0 = max1 > max0 ? max1 : max0;
+    auto min = min0[0];
+    auto max = max0[0];
+    for (std::ptrdiff_t i = 1; i < lanes; i++) {
+        min = std::min(min, min0[i]);
+        max = std::max(max, max0[i]);
+    }
+
+    return { min, max };
+}
+
+template <class T>
+using MinMaxFunction = std::tuple<T, T> (*)(const T*, const T*);
+
+#if defined(__x86_64__) || defined(__i386__)
+
+template <class T> __attribute__((target("avx2")))
+std::tuple<T, T> MinMaxAVX2(const T* first, const T* last) {
+    return MinMaxVector<T, 32>(first, last);
+}
+
+// 64-bit integer compare (pcmpgtq) is SSE4.2; see MinMaxKernel below.
+template <class T> __attribute__((target("sse4.2")))
+std::tuple<T, T> MinMaxSSE4(const T* first, const T* last) {
+    return MinMaxVector<T, 16>(first, last);
+}
+
+template <class T>
+MinMaxFunction<T> MinMaxKernel() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return MinMaxAVX2<T>;
+    if (sizeof(T) == 8 && !std::is_floating_point<T>::value) {
+        if (__builtin_cpu_supports("sse4.2")) return MinMaxSSE4<T>;
+    } else {
+        if (__builtin_cpu_supports("sse4.1")) return MinMaxSSE4<T>;
+    }
+    return MinMaxScalar<T>;
+}
+
+#else
+
+template <class T>
+std::tuple<T, T> MinMaxVector16(const T* first, const T* last) {
+    return MinMaxVector<T, 16>(first, last);
+}
+
+template <class T>
+MinMaxFunction<T> MinMaxKernel() {
+    return MinMaxVector16<T>;
+}
+
+#endif
+
+template <class T>
+std::tuple<T, T> MinMax(const T* first, const T* last) {
+    static_assert(std::is_same<T, int>::value || std::is_same<T, int64_t>::value ||
+                  std::is_same<T, float>::value || std::is_same<T, double>::value,
+                  "MinMax kernels exist for int, int64_t, float and double");
+    static const MinMaxFunction<T> kernel = MinMaxKernel<T>();
+    return kernel(first, last);
+}
+
 struct Node {
     int value;
     Node* left;
@@ -97,3 +367,529 @@ std::tuple<int, int> MinMaxBST(Node* root) {
 
     return { min, max };
 }
+
+// -----------------------------------------------------------------------------
+// Lookup and cleanup for the pointer BST, and the arena BST declared at the top.
+
+bool ContainsInBST(Node* root, int value) {
+    Node* n = root;
+    while (n != nullptr) {
+        if (value == n->value) return true;
+        n = value < n->value ? n->left : n->right;
+    }
+    return false;
+}
+
+// Iterative, with an explicit stack, since a degenerate tree is as deep as it is big.
+void FreeBST(Node* root) {
+    std::vector<Node*> stack;
+    if (root != nullptr) stack.push_back(root);
+    while (!stack.empty()) {
+        Node* n = stack.back();
+        stack.pop_back();
+        if (n->left != nullptr) stack.push_back(n->left);
+        if (n->right != nullptr) stack.push_back(n->right);
+        delete n;
+    }
+}
+
+void InsertInBST(ArenaBST& tree, int value) {
+    auto node = uint32_t(tree.nodes.size());
+    tree.nodes.push_back(ArenaNode { value, ArenaBST::nil, ArenaBST::nil });
+
+    if (tree.root == ArenaBST::nil) {
+        tree.root = node;
+        return;
+    }
+
+    // Take the arena's address only after push_back, which may have moved it.
+    ArenaNode* nodes = tree.nodes.data();
+    uint32_t n = tree.root;
+    while (1) {
+        uint32_t& child = value <= nodes[n].value ? nodes[n].left : nodes[n].right;
+        if (child == ArenaBST::nil) {
+            child = node;
+            return;
+        }
+        n = child;
+    }
+}
+
+bool ContainsInBST(const ArenaBST& tree, int value) {
+    const ArenaNode* nodes = tree.nodes.data();
+    uint32_t n = tree.root;
+    while (n != ArenaBST::nil) {
+        if (value == nodes[n].value) return true;
+        n = value < nodes[n].value ? nodes[n].left : nodes[n].right;
+    }
+    return false;
+}
+
+std::tuple<int, int> MinMaxBST(const ArenaBST& tree) {
+    if (tree.root == ArenaBST::nil) return { 0, 0 };
+
+    const ArenaNode* nodes = tree.nodes.data();
+
+    auto leftmostnode = tree.root;
+    while (nodes[leftmostnode].left != ArenaBST::nil) leftmostnode = nodes[leftmostnode].left;
+    auto min = nodes[leftmostnode].value;
+
+    auto rightmostnode = tree.root;
+    while (nodes[rightmostnode].right != ArenaBST::nil) rightmostnode = nodes[rightmostnode].right;
+    auto max = nodes[rightmostnode].value;
+
+    return { min, max };
+}
+
+// -----------------------------------------------------------------------------
+// AVL tree in an arena, declared at the top.  Same ordering as the other
+// trees: equal values go to the left.
+
+int32_t HeightInBST(const BalancedBST& tree, uint32_t n) {
+    return n == BalancedBST::nil ? 0 : tree.nodes[n].height;
+}
+
+void UpdateHeightInBST(BalancedBST& tree, uint32_t n) {
+    auto& node = tree.nodes[n];
+    node.height = 1 + std::max(HeightInBST(tree, node.left), HeightInBST(tree, node.right));
+}
+
+uint32_t RotateRightInBST(BalancedBST& tree, uint32_t n) {
+    uint32_t l = tree.nodes[n].left;
+    tree.nodes[n].left = tree.nodes[l].right;
+    tree.nodes[l].right = n;
+    UpdateHeightInBST(tree, n);
+    UpdateHeightInBST(tree, l);
+    return l;
+}
+
+uint32_t RotateLeftInBST(BalancedBST& tree, uint32_t n) {
+    uint32_t r = tree.nodes[n].right;
+    tree.nodes[n].right = tree.nodes[r].left;
+    tree.nodes[r].left = n;
+    UpdateHeightInBST(tree, n);
+    UpdateHeightInBST(tree, r);
+    return r;
+}
+
+// Inserts the already-allocated node `node` under subtree `n`; returns the
+// subtree's new root.  Recursion depth is the tree height, at most 1.44 log2(n).
+uint32_t InsertInBST(BalancedBST& tree, uint32_t n, uint32_t node) {
+    if (n == BalancedBST::nil) return node;
+
+    auto value = tree.nodes[node].value;
+    if (value <= tree.nodes[n].value) {
+        auto left = InsertInBST(tree, tree.nodes[n].left, node);
+        tree.nodes[n].left = left;
+    } else {
+        auto right = InsertInBST(tree, tree.nodes[n].right, node);
+        tree.nodes[n].right = right;
+    }
+    UpdateHeightInBST(tree, n);
+
+    auto balance = HeightInBST(tree, tree.nodes[n].left) - HeightInBST(tree, tree.nodes[n].right);
+    if (balance > 1) {
+        auto l = tree.nodes[n].left;
+        if (HeightInBST(tree, tree.nodes[l].left) < HeightInBST(tree, tree.nodes[l].right)) {
+            tree.nodes[n].left = RotateLeftInBST(tree, l);
+        }
+        return RotateRightInBST(tree, n);
+    }
+    if (balance < -1) {
+        auto r = tree.nodes[n].right;
+        if (HeightInBST(tree, tree.nodes[r].right) < HeightInBST(tree, tree.nodes[r].left)) {
+            tree.nodes[n].right = RotateRightInBST(tree, r);
+        }
+        return RotateLeftInBST(tree, n);
+    }
+    return n;
+}
+
+void InsertInBST(BalancedBST& tree, int value) {
+    auto node = uint32_t(tree.nodes.size());
+    tree.nodes.push_back(AVLNode { value, BalancedBST::nil, BalancedBST::nil, 1 });
+
+    if (tree.root == BalancedBST::nil) {
+        tree.min = tree.max = value;
+    } else {
+        tree.min = std::min(tree.min, value);
+        tree.max = std::max(tree.max, value);
+    }
+    tree.root = InsertInBST(tree, tree.root, node);
+}
+
+// Builds the subtree over sorted[lo, hi); node i holds sorted[i], so the
+// arena ends up in sorted order.  Returns the subtree's root.
+uint32_t BulkLoadBST(BalancedBST& tree, uint32_t lo, uint32_t hi) {
+    if (lo == hi) return BalancedBST::nil;
+
+    uint32_t mid = lo + (hi - lo) / 2;
+    auto& node = tree.nodes[mid];
+    node.left = BulkLoadBST(tree, lo, mid);
+    node.right = BulkLoadBST(tree, mid + 1, hi);
+    UpdateHeightInBST(tree, mid);
+    return mid;
+}
+
+BalancedBST BulkLoadBST(const int* first, const int* last) {
+    BalancedBST tree;
+    if (first == last) return tree;
+
+    tree.nodes.reserve(last - first);
+    for (auto p = first; p != last; p++) {
+        tree.nodes.push_back(AVLNode { *p, BalancedBST::nil, BalancedBST::nil, 1 });
+    }
+    tree.root = BulkLoadBST(tree, 0, uint32_t(tree.nodes.size()));
+    tree.min = *first;
+    tree.max = *(last - 1);
+    return tree;
+}
+
+bool ContainsInBST(const BalancedBST& tree, int value) {
+    const AVLNode* nodes = tree.nodes.data();
+    uint32_t n = tree.root;
+    while (n != BalancedBST::nil) {
+        if (value == nodes[n].value) return true;
+        n = value < nodes[n].value ? nodes[n].left : nodes[n].right;
+    }
+    return false;
+}
+
+// O(1): no walking down the spines.
+std::tuple<int, int> MinMaxBST(const BalancedBST& tree) {
+    if (tree.root == BalancedBST::nil) return { 0, 0 };
+    return { tree.min, tree.max };
+}
+
+// -----------------------------------------------------------------------------
+// Eytzinger search index, declared at the top.
+//
+// The search loop is branchless: k = 2k + (keys[k] < value) goes down one
+// level, and the path taken is recorded in the bits of k.  When k falls off
+// the bottom, the last left turn is where the lower bound was; shifting out
+// the trailing right turns (trailing 1 bits) and that left turn gets back to it.
+// The found key is returned by pointer into keys, or nullptr for "end".
+
+void InOrderKeys(Node* root, std::vector<int>& keys) {
+    std::vector<Node*> stack;
+    Node* n = root;
+    while (n != nullptr || !stack.empty()) {
+        for (; n != nullptr; n = n->left) stack.push_back(n);
+        n = stack.back();
+        stack.pop_back();
+        keys.push_back(n->value);
+        n = n->right;
+    }
+}
+
+template <class ArenaTree>
+void InOrderKeys(const ArenaTree& tree, std::vector<int>& keys) {
+    std::vector<uint32_t> stack;
+    uint32_t n = tree.root;
+    while (n != ArenaTree::nil || !stack.empty()) {
+        for (; n != ArenaTree::nil; n = tree.nodes[n].left) stack.push_back(n);
+        n = stack.back();
+        stack.pop_back();
+        keys.push_back(tree.nodes[n].value);
+        n = tree.nodes[n].right;
+    }
+}
+
+// Fills index.keys[k] and its subtree from the sorted keys, in order; returns
+// the position of the next sorted key to use.
+const int* BuildIndex(EytzingerIndex& index, const int* sorted, size_t k) {
+    if (k < index.keys.size()) {
+        sorted = BuildIndex(index, sorted, 2 * k);
+        index.keys[k] = *sorted++;
+        sorted = BuildIndex(index, sorted, 2 * k + 1);
+    }
+    return sorted;
+}
+
+EytzingerIndex BuildIndex(const int* sorted_first, const int* sorted_last) {
+    EytzingerIndex index;
+    index.keys.resize(sorted_last - sorted_first + 1);
+    BuildIndex(index, sorted_first, 1);
+    return index;
+}
+
+EytzingerIndex BuildIndex(Node* root) {
+    std::vector<int> keys;
+    InOrderKeys(root, keys);
+    return BuildIndex(keys.data(), keys.data() + keys.size());
+}
+
+template <class ArenaTree>
+EytzingerIndex BuildIndex(const ArenaTree& tree) {
+    std::vector<int> keys;
+    keys.reserve(tree.Size());
+    InOrderKeys(tree, keys);
+    return BuildIndex(keys.data(), keys.data() + keys.size());
+}
+
+// 16 ints are one 64-byte cache line: the 16 descendants four levels down.
+constexpr size_t IndexPrefetchDistance = 16;
+
+inline const int* FoundInIndex(const EytzingerIndex& index, size_t k) {
+    k >>= __builtin_ffsll(~k);
+    return k == 0 ? nullptr : &index.keys[k];
+}
+
+const int* LowerBoundInIndex(const EytzingerIndex& index, int value) {
+    const int* keys = index.keys.data();
+    size_t size = index.Size();
+    size_t k = 1;
+    while (k <= size) {
+        __builtin_prefetch(keys + IndexPrefetchDistance * k);
+        k = 2 * k + (keys[k] < value);
+    }
+    return FoundInIndex(index, k);
+}
+
+const int* UpperBoundInIndex(const EytzingerIndex& index, int value) {
+    const int* keys = index.keys.data();
+    size_t size = index.Size();
+    size_t k = 1;
+    while (k <= size) {
+        __builtin_prefetch(keys + IndexPrefetchDistance * k);
+        k = 2 * k + (keys[k] <= value);
+    }
+    return FoundInIndex(index, k);
+}
+
+bool ContainsInIndex(const EytzingerIndex& index, int value) {
+    auto found = LowerBoundInIndex(index, value);
+    return found != nullptr && *found == value;
+}
+
+// Batched lower_bound: walks a group of queries down the index together, one
+// level at a time, so that their cache misses overlap instead of queueing.
+// Every query takes the same number of steps over the complete levels;
+// only the last, partial level needs a check.
+void LowerBoundInIndex(const EytzingerIndex& index, const int* values, size_t count, const int** results) {
+    constexpr size_t group = 16;
+    const int* keys = index.keys.data();
+    size_t size = index.Size();
+    int complete_levels = size == 0 ? 0 : 63 - __builtin_clzll(size + 1);
+
+    for (size_t first = 0; first < count; first += group) {
+        size_t n = std::min(group, count - first);
+        size_t ks[group];
+        for (size_t i = 0; i < n; i++) ks[i] = 1;
+
+        for (int level = 0; level < complete_levels; level++) {
+            for (size_t i = 0; i < n; i++) {
+                __builtin_prefetch(keys + IndexPrefetchDistance * ks[i]);
+                ks[i] = 2 * ks[i] + (keys[ks[i]] < values[first + i]);
+            }
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (ks[i] <= size) ks[i] = 2 * ks[i] + (keys[ks[i]] < values[first + i]);
+            results[first + i] = FoundInIndex(index, ks[i]);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Benchmark: MinMax(std::vector<int>), MinMax(first, last), std::minmax_element.
+
+#include <chrono>  // steady_clock, duration, duration_cast
+#include <random>  // mt19937, uniform_int_distribution, uniform_real_distribution
+#include <numeric> // iota
+
+template <class F> double SecondsToRun(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
+}
+
+template <class T>
+void BenchmarkMinMaxOf(const char* type, const std::vector<T>& vec) {
+    auto first = vec.data();
+    auto last = vec.data() + vec.size();
+
+    std::tuple<T, T> simd;
+    auto simd_seconds = SecondsToRun([&] { simd = MinMax(first, last); });
+
+    std::tuple<T, T> scalar;
+    auto scalar_seconds = SecondsToRun([&] { scalar = MinMaxScalar(first, last); });
+
+    std::tuple<T, T> stl;
+    auto stl_seconds = SecondsToRun([&] {
+        auto minmax = std::minmax_element(first, last);
+        stl = std::make_tuple(*minmax.first, *minmax.second);
+    });
+
+    std::cout << type << ": MinMax(first, last) " << simd_seconds << "s, "
+              << "scalar loop " << scalar_seconds << "s, "
+              << "std::minmax_element " << stl_seconds << "s"
+              << (simd == scalar && simd == stl ? "" : "  MISMATCH") << std::endl;
+}
+
+void BenchmarkMinMax() {
+    const size_t size = 50000000;
+    std::cout << "BenchmarkMinMax over " << size << " elements:" << std::endl;
+
+    std::mt19937 rand_gen;
+    std::uniform_int_distribution<int64_t> int_dist(-1000000000, 1000000000);
+    std::uniform_real_distribution<double> real_dist(-1e9, 1e9);
+
+    std::vector<int> ints(size);
+    for (auto& x : ints) x = int(int_dist(rand_gen));
+
+    std::tuple<int, int> copied;
+    auto copied_seconds = SecondsToRun([&] { copied = MinMax(ints); });
+    std::cout << "int: MinMax(std::vector<int>) " << copied_seconds << "s" << std::endl;
+    BenchmarkMinMaxOf("int", ints);
+    ints = std::vector<int>();
+
+    std::vector<int64_t> int64s(size);
+    for (auto& x : int64s) x = int_dist(rand_gen) * 1000;
+    BenchmarkMinMaxOf("int64_t", int64s);
+    int64s = std::vector<int64_t>();
+
+    std::vector<float> floats(size);
+    for (auto& x : floats) x = float(real_dist(rand_gen));
+    BenchmarkMinMaxOf("float", floats);
+    floats = std::vector<float>();
+
+    std::vector<double> doubles(size);
+    for (auto& x : doubles) x = real_dist(rand_gen);
+    BenchmarkMinMaxOf("double", doubles);
+
+    std::cout << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// Benchmark: insert and lookup throughput, pointer BST vs. arena BST.
+
+void BenchmarkBSTOf(size_t size) {
+    std::mt19937 rand_gen;
+    std::uniform_int_distribution<int> dist;
+    std::vector<int> keys(size);
+    for (auto& x : keys) x = dist(rand_gen);
+    std::vector<int> queries(keys);
+    std::shuffle(queries.begin(), queries.end(), rand_gen);
+
+    size_t found = 0;
+
+    Node* bst = nullptr;
+    auto insert_seconds = SecondsToRun([&] { for (auto x : keys) bst = InsertInBST(bst, x); });
+    auto lookup_seconds = SecondsToRun([&] { for (auto x : queries) found += ContainsInBST(bst, x); });
+    auto minmax = MinMaxBST(bst);
+    auto free_seconds = SecondsToRun([&] { FreeBST(bst); });
+    std::cout << size << " keys, Node*:    "
+              << size / insert_seconds / 1e6 << " M inserts/s, "
+              << size / lookup_seconds / 1e6 << " M lookups/s, "
+              << "free " << free_seconds << "s" << std::endl;
+
+    ArenaBST arenabst;
+    insert_seconds = SecondsToRun([&] { for (auto x : keys) InsertInBST(arenabst, x); });
+    lookup_seconds = SecondsToRun([&] { for (auto x : queries) found += ContainsInBST(arenabst, x); });
+    auto arenaminmax = MinMaxBST(arenabst);
+    free_seconds = SecondsToRun([&] { arenabst.Clear(); });
+    std::cout << size << " keys, ArenaBST: "
+              << size / insert_seconds / 1e6 << " M inserts/s, "
+              << size / lookup_seconds / 1e6 << " M lookups/s, "
+              << "free " << free_seconds << "s"
+              << (found == 2 * size && minmax == arenaminmax ? "" : "  MISMATCH") << std::endl;
+}
+
+void BenchmarkBST() {
+    std::cout << "BenchmarkBST with random keys:" << std::endl;
+    BenchmarkBSTOf(1000000);
+    BenchmarkBSTOf(10000000);
+    std::cout << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// Benchmark: building from sorted keys, which makes the unbalanced trees
+// degenerate into linked lists.  The unbalanced ones get far fewer keys.
+
+void BenchmarkBalancedBSTOf(size_t size, bool unbalanced_too) {
+    std::vector<int> keys(size);
+    std::iota(keys.begin(), keys.end(), 0);
+
+    if (unbalanced_too) {
+        Node* bst = nullptr;
+        std::tuple<int, int> minmax;
+        auto insert_seconds = SecondsToRun([&] { for (auto x : keys) bst = InsertInBST(bst, x); });
+        auto minmax_seconds = SecondsToRun([&] { minmax = MinMaxBST(bst); });
+        FreeBST(bst);
+        std::cout << size << " sorted keys, Node*:       build " << insert_seconds << "s, "
+                  << "MinMaxBST " << minmax_seconds << "s, max " << std::get<1>(minmax) << std::endl;
+
+        ArenaBST arenabst;
+        insert_seconds = SecondsToRun([&] { for (auto x : keys) InsertInBST(arenabst, x); });
+        minmax_seconds = SecondsToRun([&] { minmax = MinMaxBST(arenabst); });
+        std::cout << size << " sorted keys, ArenaBST:    build " << insert_seconds << "s, "
+                  << "MinMaxBST " << minmax_seconds << "s, max " << std::get<1>(minmax) << std::endl;
+    }
+
+    BalancedBST balancedbst;
+    std::tuple<int, int> minmax;
+    auto insert_seconds = SecondsToRun([&] { for (auto x : keys) InsertInBST(balancedbst, x); });
+    auto minmax_seconds = SecondsToRun([&] { minmax = MinMaxBST(balancedbst); });
+    std::cout << size << " sorted keys, BalancedBST: build " << insert_seconds << "s, "
+              << "MinMaxBST " << minmax_seconds << "s, "
+              << "height " << HeightInBST(balancedbst, balancedbst.root) << std::endl;
+    balancedbst.Clear();
+
+    BalancedBST bulkbst;
+    auto bulk_seconds = SecondsToRun([&] { bulkbst = BulkLoadBST(keys.data(), keys.data() + size); });
+    size_t found = 0;
+    auto lookup_seconds = SecondsToRun([&] { for (auto x : keys) found += ContainsInBST(bulkbst, x); });
+    std::cout << size << " sorted keys, BulkLoadBST: build " << bulk_seconds << "s, "
+              << size / lookup_seconds / 1e6 << " M lookups/s, "
+              << "height " << HeightInBST(bulkbst, bulkbst.root)
+              << (found == size && MinMaxBST(bulkbst) == minmax ? "" : "  MISMATCH") << std::endl;
+}
+
+void BenchmarkBalancedBST() {
+    std::cout << "BenchmarkBalancedBST:" << std::endl;
+    BenchmarkBalancedBSTOf(20000, true);
+    BenchmarkBalancedBSTOf(10000000, false);
+    std::cout << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// Benchmark: lookups in the BSTs vs. the frozen Eytzinger index.
+
+void BenchmarkIndex() {
+    const size_t size = 2000000;
+    std::cout << "BenchmarkIndex over " << size << " random keys:" << std::endl;
+
+    std::mt19937 rand_gen;
+    std::uniform_int_distribution<int> dist;
+    std::vector<int> keys(size);
+    for (auto& x : keys) x = dist(rand_gen);
+    std::vector<int> queries(size);
+    for (size_t i = 0; i < size; i++) queries[i] = i % 2 ? keys[i] : dist(rand_gen);
+    std::shuffle(queries.begin(), queries.end(), rand_gen);
+
+    Node* bst = nullptr;
+    for (auto x : keys) bst = InsertInBST(bst, x);
+    BalancedBST balancedbst;
+    for (auto x : keys) InsertInBST(balancedbst, x);
+    auto index = BuildIndex(bst);
+
+    size_t bst_found = 0, balanced_found = 0, index_found = 0, batch_found = 0;
+    auto bst_seconds = SecondsToRun([&] { for (auto x : queries) bst_found += ContainsInBST(bst, x); });
+    auto balanced_seconds = SecondsToRun([&] { for (auto x : queries) balanced_found += ContainsInBST(balancedbst, x); });
+    auto index_seconds = SecondsToRun([&] { for (auto x : queries) index_found += ContainsInIndex(index, x); });
+    std::vector<const int*> results(size);
+    auto batch_seconds = SecondsToRun([&] {
+        LowerBoundInIndex(index, queries.data(), size, results.data());
+        for (size_t i = 0; i < size; i++) batch_found += results[i] != nullptr && *results[i] == queries[i];
+    });
+    FreeBST(bst);
+
+    std::cout << "Node*:              " << size / bst_seconds / 1e6 << " M lookups/s" << std::endl;
+    std::cout << "BalancedBST:        " << size / balanced_seconds / 1e6 << " M lookups/s" << std::endl;
+    std::cout << "EytzingerIndex:     " << size / index_seconds / 1e6 << " M lookups/s" << std::endl;
+    std::cout << "EytzingerIndex x16: " << size / batch_seconds / 1e6 << " M lookups/s"
+              << (bst_found == balanced_found && bst_found == index_found && bst_found == batch_found ? "" : "  MISMATCH")
+              << std::endl;
+    std::cout << std::endl;
+}